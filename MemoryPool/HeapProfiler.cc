@@ -0,0 +1,190 @@
+//
+//HeapProfiler.cc
+//
+
+#include "HeaderFiles.h"
+#include "HeapProfiler.h"
+
+#include <atomic>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <execinfo.h>
+#endif
+
+namespace MemoryPool
+{
+	static const int HEAP_PROFILER_SKIPPED_FRAMES = 3;	//CaptureCallStack() / RecordAllocation() / MemoryPool::GetChunks()
+
+	HEAP_PROFILER_THREAD_LOCAL HeapProfilerCountdown g_Countdowns[HEAP_PROFILER_COUNTDOWN_SLOTS];	//zero-initialized, as every thread-local
+	static std::atomic<unsigned int> g_uiLastProfilerId(0);
+	static HEAP_PROFILER_THREAD_LOCAL unsigned long long g_ullRandomState = 0;	//state of the random generator of the thread
+
+	//
+	//Constructor
+	//
+	HeapProfiler::HeapProfiler(const std::size_t &sSampleInterval)
+	{
+		m_sSampleInterval = ((sSampleInterval > 0) ? sSampleInterval : 1);
+		m_uiProfilerId = ++g_uiLastProfilerId;
+		m_uiCountdownSlot = m_uiProfilerId % HEAP_PROFILER_COUNTDOWN_SLOTS;
+	}
+
+	//
+	//Destructor
+	//
+	HeapProfiler::~HeapProfiler()
+	{
+	}
+
+	//
+	//RecordAllocation
+	//
+	bool HeapProfiler::RecordAllocation(void *ptrMemoryBlock, const std::size_t &sMemorySize)
+	{
+		HeapProfilerCountdown &countdown = g_Countdowns[m_uiCountdownSlot];
+		if (countdown.Owner != m_uiProfilerId)
+		{
+			//The countdown was not started yet, or by a HeapProfiler sharing the slot (e.g. a deleted one) : restart it.
+			//The distance between samples is exponentially distributed (memoryless), so the restart does not bias the samples.
+			countdown.Owner = m_uiProfilerId;
+			countdown.BytesUntilSample = PickNextSampleInterval() - (std::ptrdiff_t)sMemorySize;
+			if (countdown.BytesUntilSample >= 0)
+			{
+				return false;
+			}
+		}
+		countdown.BytesUntilSample = PickNextSampleInterval();
+
+		void *ptrFrames[HEAP_PROFILER_MAX_STACK_DEPTH + HEAP_PROFILER_SKIPPED_FRAMES];
+		int iFrames = CaptureCallStack(ptrFrames, HEAP_PROFILER_MAX_STACK_DEPTH + HEAP_PROFILER_SKIPPED_FRAMES);
+		int iSkippedFrames = ((iFrames > HEAP_PROFILER_SKIPPED_FRAMES) ? HEAP_PROFILER_SKIPPED_FRAMES : 0);
+		CallStack callStack(ptrFrames + iSkippedFrames, ptrFrames + iFrames);
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		HeapProfileBucket &bucket = m_Buckets[callStack];	//value-initialized (all 0) for a new call-stack
+		bucket.LiveCount++;
+		bucket.LiveBytes += sMemorySize;
+		bucket.TotalCount++;
+		bucket.TotalBytes += sMemorySize;
+
+		HeapProfileSample sample;
+		sample.Size = sMemorySize;
+		sample.Bucket = &bucket;	//std::map never moves its elements
+		m_LiveSamples[ptrMemoryBlock] = sample;
+		return true;
+	}
+
+	//
+	//RecordFree
+	//
+	void HeapProfiler::RecordFree(void *ptrMemoryBlock)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		std::unordered_map<void*, HeapProfileSample>::iterator itSample = m_LiveSamples.find(ptrMemoryBlock);
+		if (itSample != m_LiveSamples.end())
+		{
+			itSample->second.Bucket->LiveCount--;
+			itSample->second.Bucket->LiveBytes -= itSample->second.Size;
+			m_LiveSamples.erase(itSample);
+		}
+	}
+
+	//
+	//RecordMove
+	//
+	void HeapProfiler::RecordMove(void *ptrOldMemoryBlock, void *ptrNewMemoryBlock)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		std::unordered_map<void*, HeapProfileSample>::iterator itSample = m_LiveSamples.find(ptrOldMemoryBlock);
+		if (itSample != m_LiveSamples.end())
+		{
+			HeapProfileSample sample = itSample->second;
+			m_LiveSamples.erase(itSample);
+			m_LiveSamples[ptrNewMemoryBlock] = sample;
+		}
+	}
+
+	//
+	//WriteProfile
+	//
+	bool HeapProfiler::WriteProfile(std::ostream &osOutput)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		std::size_t sLiveCount = 0, sLiveBytes = 0, sTotalCount = 0, sTotalBytes = 0;
+		std::map<CallStack, HeapProfileBucket>::const_iterator itBucket;
+		for (itBucket = m_Buckets.begin(); itBucket != m_Buckets.end(); ++itBucket)
+		{
+			sLiveCount += itBucket->second.LiveCount;
+			sLiveBytes += itBucket->second.LiveBytes;
+			sTotalCount += itBucket->second.TotalCount;
+			sTotalBytes += itBucket->second.TotalBytes;
+		}
+
+		//The counts are the raw samples, pprof scales them up using the sample interval from the header
+		osOutput << "heap profile: " << sLiveCount << ": " << sLiveBytes << " [" << sTotalCount << ": " << sTotalBytes << "] @ heap_v2/" << m_sSampleInterval << "\n";
+		for (itBucket = m_Buckets.begin(); itBucket != m_Buckets.end(); ++itBucket)
+		{
+			const HeapProfileBucket &bucket = itBucket->second;
+			osOutput << bucket.LiveCount << ": " << bucket.LiveBytes << " [" << bucket.TotalCount << ": " << bucket.TotalBytes << "] @";
+			for (std::size_t i = 0; i < itBucket->first.size(); i++)
+			{
+				osOutput << " " << itBucket->first[i];
+			}
+			osOutput << "\n";
+		}
+
+#ifdef __linux__
+		std::ifstream ifMaps("/proc/self/maps");
+		if (ifMaps.good())
+		{
+			osOutput << "\nMAPPED_LIBRARIES:\n" << ifMaps.rdbuf();
+		}
+#endif
+		osOutput.flush();
+		return osOutput.good();
+	}
+
+	//
+	//GetLiveSamples
+	//
+	std::size_t HeapProfiler::GetLiveSamples(std::size_t &sLiveBytes)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		sLiveBytes = 0;
+		std::unordered_map<void*, HeapProfileSample>::const_iterator itSample;
+		for (itSample = m_LiveSamples.begin(); itSample != m_LiveSamples.end(); ++itSample)
+		{
+			sLiveBytes += itSample->second.Size;
+		}
+		return m_LiveSamples.size();
+	}
+
+	//
+	//PickNextSampleInterval
+	//
+	std::ptrdiff_t HeapProfiler::PickNextSampleInterval()
+	{
+		if (g_ullRandomState == 0)
+		{
+			g_ullRandomState = ((unsigned long long)(std::size_t)&g_ullRandomState) ^ ((unsigned long long)time(NULL) << 20) ^ 0x9E3779B97F4A7C15ULL;
+		}
+		g_ullRandomState = (g_ullRandomState * 6364136223846793005ULL) + 1442695040888963407ULL;	//64 bit LCG, the high bits are good enough
+
+		double dRandom = ((double)((g_ullRandomState >> 11) + 1)) / 9007199254740992.0;	//(0, 1]
+		return (std::ptrdiff_t)(-log(dRandom) * (double)m_sSampleInterval) + 1;
+	}
+
+	//
+	//CaptureCallStack
+	//
+	int HeapProfiler::CaptureCallStack(void **ptrFrames, int iMaxFrames)
+	{
+#ifdef _WIN32
+		return (int)CaptureStackBackTrace(0, (DWORD)iMaxFrames, ptrFrames, NULL);
+#else
+		return backtrace(ptrFrames, iMaxFrames);
+#endif
+	}
+}
@@ -0,0 +1,107 @@
+//
+//HeapProfiler.h
+//
+//Contains the HeapProfiler class definition
+//A sampling heap profiler for the MemoryPool : about one allocation per "sSampleInterval" Bytes is sampled and its call-stack
+//recorded. Allocations which are not sampled only cost a decrement of a per-thread byte countdown (see "ShouldSample()").
+//The live samples can be written as a heap profile, which can be read by pprof (legacy "heap_v2" text format).
+//
+
+#ifndef _HEAPPROFILER_H
+#define _HEAPPROFILER_H
+
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include "MemoryBlock.h"
+
+#ifdef _MSC_VER
+#define HEAP_PROFILER_THREAD_LOCAL __declspec(thread)	//VS2013 has no "thread_local"
+#else
+#define HEAP_PROFILER_THREAD_LOCAL __thread
+#endif
+
+namespace MemoryPool
+{
+	static const std::size_t DEFAULT_HEAP_PROFILER_SAMPLE_INTERVAL = 512 * 1024;	//Default average distance (in Bytes) between two samples
+	static const int HEAP_PROFILER_MAX_STACK_DEPTH = 32;								//Maximum number of frames recorded for a sample
+	static const unsigned int HEAP_PROFILER_COUNTDOWN_SLOTS = 8;						//Countdowns per thread, so up to this many profilers don't restart each other's countdown
+
+	typedef struct HeapProfilerCountdown
+	{
+		std::ptrdiff_t BytesUntilSample;	//the next allocation is sampled when it drops below 0
+		unsigned int Owner;					//Id of the HeapProfiler which started the countdown, 0 = none
+	}HeapProfilerCountdown;
+
+	//per-thread countdowns, a HeapProfiler uses the slot "Id % HEAP_PROFILER_COUNTDOWN_SLOTS" (the Ids are consecutive)
+	extern HEAP_PROFILER_THREAD_LOCAL HeapProfilerCountdown g_Countdowns[HEAP_PROFILER_COUNTDOWN_SLOTS];
+
+	class HeapProfiler
+	{
+	public:
+		//Contructor Param:
+		//sSampleInterval :			Average distance (in Bytes) between two sampled allocations. The distance is random, so every byte
+		//							has the same chance to be sampled.
+		HeapProfiler(const std::size_t &sSampleInterval = DEFAULT_HEAP_PROFILER_SAMPLE_INTERVAL);
+		~HeapProfiler();
+
+		//ShouldSample :			Count down "sMemorySize" Bytes for the current thread. This is the only work done for an allocation which is not sampled.
+		//<Return> :				true, if the allocation should be passed to "RecordAllocation()".
+		bool ShouldSample(const std::size_t &sMemorySize)
+		{
+			HeapProfilerCountdown &countdown = g_Countdowns[m_uiCountdownSlot];
+			countdown.BytesUntilSample -= (std::ptrdiff_t)sMemorySize;
+			return ((countdown.BytesUntilSample < 0) || (countdown.Owner != m_uiProfilerId));
+		}
+
+		//RecordAllocation :		Record the call-stack of an allocation, for which "ShouldSample()" returned true.
+		//<Return> :				true, if the allocation was sampled (the profiler has to be told, when it is freed or moved)
+		bool RecordAllocation(void *ptrMemoryBlock, const std::size_t &sMemorySize);
+
+		//RecordFree :				Forget a sampled allocation, when it is freed.
+		void RecordFree(void *ptrMemoryBlock);
+
+		//RecordMove :				Update a sampled allocation, which has been moved (e.g. by "MemoryPool::Compact()").
+		void RecordMove(void *ptrOldMemoryBlock, void *ptrNewMemoryBlock);
+
+		//WriteProfile :			Write the live samples grouped by call-stack, in pprof's heap profile format. (On Linux, the memory map
+		//							of the process is appended, so pprof can symbolize the addresses.)
+		//<Return> :				true on success, false otherwise
+		bool WriteProfile(std::ostream &osOutput);
+
+		//GetLiveSamples :			return the number of live (sampled, not yet freed) allocations and their size in Bytes.
+		std::size_t GetLiveSamples(std::size_t &sLiveBytes);
+
+	private:
+		typedef std::vector<void*> CallStack;
+
+		typedef struct HeapProfileBucket
+		{
+			std::size_t LiveCount;		//number of sampled allocations from this call-stack, which have not been freed
+			std::size_t LiveBytes;		//their size in Bytes
+			std::size_t TotalCount;		//number of sampled allocations from this call-stack
+			std::size_t TotalBytes;		//their size in Bytes
+		}HeapProfileBucket;
+
+		typedef struct HeapProfileSample
+		{
+			std::size_t Size;				//size of the allocation in Bytes
+			HeapProfileBucket *Bucket;		//bucket of the call-stack, which did the allocation
+		}HeapProfileSample;
+
+		std::ptrdiff_t PickNextSampleInterval();	//return a random distance to the next sample (exponential distribution with mean "m_sSampleInterval")
+		static int CaptureCallStack(void **ptrFrames, int iMaxFrames);	//Store the return addresses of the current call-stack in "ptrFrames", return the number of frames
+
+		std::size_t m_sSampleInterval;								//Average distance (in Bytes) between two samples
+		unsigned int m_uiProfilerId;								//Unique Id (> 0), see "HeapProfilerCountdown::Owner"
+		unsigned int m_uiCountdownSlot;								//Index of the countdown of this profiler in "g_Countdowns"
+		std::mutex m_Mutex;											//Protects the maps, only taken for sampled allocations
+		std::map<CallStack, HeapProfileBucket> m_Buckets;			//Statistics per call-stack
+		std::unordered_map<void*, HeapProfileSample> m_LiveSamples;	//Sampled allocations which have not been freed
+	};
+}
+
+#endif //_HEAPPROFILER_H
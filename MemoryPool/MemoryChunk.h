@@ -3,7 +3,7 @@
 //
 //Contains the MemoryChunk definition
 //It hold and manage the actual allocated memory, every momerychunk will point 
-//to a momoryblock, and other memorychunk creating a linked list od memorychunks
+//to a momoryblock. The memorychunks of a MemorySegment are an array, a chunk is found by its index
 //
 
 #ifndef _MEMORYCHUNK_H
@@ -19,8 +19,8 @@ namespace MemoryPool
 		TByte *Data;			//The actual data
 		std::size_t DataSize;	//size of the "data" block
 		std::size_t UsedSize;	//actual used size
-		bool IsAllocationChunk;	//True:when this MemoryChunk points to a data block,which can be deallocated via free();
-		MemoryChunk *Next;		//pointer to the next Memorychunk in the list, may be NULL
+		bool IsSampled;			//True:when the allocation starting at this MemoryChunk was sampled by the HeapProfiler
+		unsigned int Handle;	//Handle owning the memory of this chunk (see "GetHandle()"), 0 if the memory was handed out as a raw pointer
 	}MemoryChunk;
 }
 
@@ -0,0 +1,37 @@
+//
+//MemoryHandle.h
+//
+//Contains the definitions for relocatable (handle based) memory.
+//A MemoryHandle is an index into the handle table of the MemoryPool. The memory behind a handle may be moved
+//by "MemoryPool::Compact()" as long as the handle is not pinned, so the memory must only be accessed between
+//"PinHandle()" and "UnpinHandle()".
+//
+
+#ifndef _MEMORYHANDLE_H
+#define _MEMORYHANDLE_H
+
+#include "MemoryChunk.h"
+
+namespace MemoryPool
+{
+	typedef unsigned int MemoryHandle;					//Indirection handle to relocatable memory
+	static const MemoryHandle INVALID_MEMORY_HANDLE = 0;	//Value 0 is never a valid handle
+
+	typedef struct MemoryHandleEntry
+	{
+		MemoryChunk *Chunk;		//first Chunk of the memory block, NULL if the entry is unused
+		unsigned int PinCount;	//number of outstanding "PinHandle()" calls, the memory is only moved when this is 0
+		unsigned int NextFree;	//index of the next unused entry in the handle table (free list), 0 at the end of the list
+	}MemoryHandleEntry;
+
+	typedef struct CompactionStats
+	{
+		std::size_t BytesMoved;			//amount of memory (in Bytes) copied to a new location
+		std::size_t BytesReleased;		//amount of memory (in Bytes) given back to the OS
+		unsigned int SegmentsReleased;	//number of MemorySegments given back to the OS
+		double FragmentationBefore;		//fragmentation of the free memory before compacting (0.0 = all free memory is one block, towards 1.0 = scattered)
+		double FragmentationAfter;		//fragmentation of the free memory after compacting
+	}CompactionStats;
+}
+
+#endif //_MEMORYHANDLE_H
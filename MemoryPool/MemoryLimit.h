@@ -0,0 +1,45 @@
+//
+//MemoryLimit.h
+//
+//Contains the definitions for the memory limits of a MemoryPool (see "MemoryPool::SetMemoryLimits()").
+//The limits apply to the size of the MemoryPool, i.e. the memory requested from the OS. When the pool grows beyond
+//the soft limit, the registered pressure callbacks are called and unused segments are given back to the OS.
+//The pool never grows beyond the hard limit, a request which does not fit fails or waits for memory to be freed.
+//
+
+#ifndef _MEMORYLIMIT_H
+#define _MEMORYLIMIT_H
+
+#include "MemoryBlock.h"
+
+namespace MemoryPool
+{
+	class MemoryPool;
+
+	static const std::size_t NO_MEMORY_LIMIT = 0;	//Value for a limit which is not set
+
+	typedef enum MemoryLimitPolicy
+	{
+		MEMORY_LIMIT_FAIL_FAST,		//A request which would grow the pool beyond the hard limit returns NULL
+		MEMORY_LIMIT_WAIT			//A request which would grow the pool beyond the hard limit waits (up to a timeout) for memory to be freed
+	}MemoryLimitPolicy;
+
+	typedef enum MemoryPressureLevel
+	{
+		MEMORY_PRESSURE_NONE,
+		MEMORY_PRESSURE_SOFT_LIMIT,	//The pool has grown beyond the soft limit
+		MEMORY_PRESSURE_HARD_LIMIT	//A request could not be served without growing the pool beyond the hard limit
+	}MemoryPressureLevel;
+
+	//MemoryPressureCallback :	Called without holding the lock of the pool, so the callback may free memory of the pool (e.g. shed a cache).
+	//							It must not allocate memory from the pool.
+	typedef void (*MemoryPressureCallback)(MemoryPool *ptrMemoryPool, MemoryPressureLevel ePressureLevel, const std::size_t &sMemoryPoolSize, void *ptrUserData);
+
+	typedef struct MemoryPressureCallbackEntry
+	{
+		MemoryPressureCallback Callback;	//function to call
+		void *UserData;						//passed to the callback unchanged
+	}MemoryPressureCallbackEntry;
+}
+
+#endif //_MEMORYLIMIT_H
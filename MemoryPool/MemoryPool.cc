@@ -16,22 +16,73 @@ namespace MemoryPool
 	MemoryPool::MemoryPool(const std::size_t &sInitialMemoryPoolSize, const std::size_t &sMemoryChunkSize,
 		const std::size_t &sMinimalMemorySizeToAllocate, bool bSetMemoryData)
 	{
-		m_ptrFirstChunk = NULL;
-		m_ptrLastChunk = NULL;
+		InitializeMembers(sMemoryChunkSize, sMinimalMemorySizeToAllocate, bSetMemoryData);
+		AllocateMemory(sInitialMemoryPoolSize);	// Allocate the Initial amount of Memory from the OS
+	}
+
+	//
+	//Constructor (child pool)
+	//
+	MemoryPool::MemoryPool(MemoryPool *ptrParentPool, const std::size_t &sInitialMemoryPoolSize)
+	{
+		//The Segments of a child are managed by the same chunk math as in the parent (these members never change after construction)
+		InitializeMembers(ptrParentPool->m_sMemoryChunkSize, ptrParentPool->m_sMinimalMemorySizeToAllocate, ptrParentPool->m_bSetMemoryData);
+		m_ptrParentPool = ptrParentPool;
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		BorrowMemory(lock, sInitialMemoryPoolSize, sInitialMemoryPoolSize);	// Borrow the Initial amount of Memory from the parent
+	}
+
+	//
+	//InitializeMembers
+	//
+	void MemoryPool::InitializeMembers(const std::size_t &sMemoryChunkSize, const std::size_t &sMinimalMemorySizeToAllocate, bool bSetMemoryData)
+	{
+		m_ptrFirstSegment = NULL;
+		m_ptrLastSegment = NULL;
+		m_ptrCursorSegment = NULL;
 		m_ptrCursorChunk = NULL;
+		m_uiSegmentCount = 0;
+
+		m_ptrHandles = NULL;
+		m_uiHandleCapacity = 0;
+		m_uiHandleCount = 1;	//entry 0 is INVALID_MEMORY_HANDLE
+		m_uiFreeHandle = 0;
 
 		m_sTotalMemoryPoolSize = 0;
 		m_sUsedMemoryPoolSize = 0;
 		m_sFreeMemoryPoolSize = 0;
 
+		assert((sMemoryChunkSize > 0) && "ERROR : The MemoryChunk size must not be 0");
 		m_sMemoryChunkSize = sMemoryChunkSize;
-		m_uiMemoryChunkCount = 0;
+		m_sMemoryChunkMask = 0;
+		m_uiMemoryChunkShift = 0;
+		if ((sMemoryChunkSize > 1) && ((sMemoryChunkSize & (sMemoryChunkSize - 1)) == 0))
+		{
+			//The chunk size is a power of two, so the chunk math can be done with shift/mask (see "CalculateNeededChunks()")
+			m_sMemoryChunkMask = sMemoryChunkSize - 1;
+			while ((((std::size_t)1) << m_uiMemoryChunkShift) < sMemoryChunkSize)
+			{
+				m_uiMemoryChunkShift++;
+			}
+		}
+		m_sMemoryChunkCount = 0;
 		m_uiObjectCount = 0;
 
 		m_bSetMemoryData = bSetMemoryData;
 		m_sMinimalMemorySizeToAllocate = sMinimalMemorySizeToAllocate;
+		m_ptrHeapProfiler = NULL;
 
-		AllocateMemory(sInitialMemoryPoolSize);	// Allocate the Initial amount of Memory from the OS
+		m_sSoftLimit = NO_MEMORY_LIMIT;
+		m_sHardLimit = NO_MEMORY_LIMIT;
+		m_eLimitPolicy = MEMORY_LIMIT_FAIL_FAST;
+		m_uiWaitTimeout = 0;
+		m_ePendingPressure = MEMORY_PRESSURE_NONE;
+		m_uiWaitingThreads = 0;
+
+		m_ptrParentPool = NULL;
+		m_bParentPressurePending = false;
+		m_ptrSpareSegments = NULL;
+		m_uiChildPoolCount = 0;
 	}
 
 	//
@@ -39,9 +90,27 @@ namespace MemoryPool
 	//
 	MemoryPool::~MemoryPool()
 	{
+		assert((m_uiChildPoolCount == 0) && "ERROR : All child pools have to be deleted before their parent");
+		std::size_t sBytesReleased = 0;
+		unsigned int uiSegmentsReleased = 0;
+		ReleaseSpareSegments(sBytesReleased, uiSegmentsReleased);
+
+		if (m_ptrParentPool)
+		{
+			//All Segments are given back to the parent in one step, the objects still allocated in a child pool are released with them
+			m_ptrParentPool->ReturnSegments(m_ptrFirstSegment, m_ptrLastSegment, true);
+			m_ptrFirstSegment = NULL;
+		}
+		else if ((m_uiObjectCount != 0) && (m_ptrHeapProfiler))
+		{
+			WriteLeakReport();	//the assert below is gone in release builds
+		}
+		delete m_ptrHeapProfiler;
+
 		FreeAllAllocatedMemory();
 		DeallocateAllChunks();
-		assert((m_uiObjectCount == 0) && "WARNING : Memory-Leak : You have not freed all allocated Memory");	// Check for possible Memory-Leaks
+		free(((void*)m_ptrHandles));
+		assert(((m_ptrParentPool) || (m_uiObjectCount == 0)) && "WARNING : Memory-Leak : You have not freed all allocated Memory");	// Check for possible Memory-Leaks
 	}
 
 	//
@@ -49,16 +118,36 @@ namespace MemoryPool
 	//
 	void *MemoryPool::GetMemory(const std::size_t &sMemorySize)
 	{
-		std::size_t sBestMemBlockSize = CalculateBestMemoryBlockSize(sMemorySize);
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		MemoryChunk *ptrChunk = GetChunks(lock, sMemorySize);
+		void *ptrMemoryBlock = (ptrChunk ? ((void*)ptrChunk->Data) : NULL);
+		HandleMemoryPressure(lock);	//the soft limit may have been crossed
+		return ptrMemoryBlock;
+	}
+
+	//
+	//GetChunks
+	//
+	MemoryChunk *MemoryPool::GetChunks(std::unique_lock<std::mutex> &lock, const std::size_t &sMemorySize)
+	{
+		//A zero-size request still gets a Chunk of its own, so it returns a valid pointer, which is not shared with another request
+		std::size_t sBestMemBlockSize = CalculateBestMemoryBlockSize(sMemorySize ? sMemorySize : 1);
+		if (sBestMemBlockSize < sMemorySize)
+		{
+			return NULL;	//the size wrapped around (e.g. SIZE_MAX), no pool can hold it
+		}
 		MemoryChunk *ptrChunk = NULL;
-		while (!ptrChunk)
+		if (m_sFreeMemoryPoolSize >= sBestMemBlockSize)	//a full pool (e.g. a child pool which never frees) does not need to be searched
 		{
 			ptrChunk = FindChunkSuitableToHoldMemory(sBestMemBlockSize);	//Is a Chunks available to hold the requested amount of Memory
+		}
+		if (!ptrChunk)
+		{
+			//No chunk can be found,so MemoryPool is to small. We have to request more Memory from the OS
+			ptrChunk = GrowMemoryPool(lock, sBestMemBlockSize);
 			if (!ptrChunk)
 			{
-				//No chunk can be found,so MemoryPool is to small. We have to request more Memory from the OS
-				sBestMemBlockSize = MaxValue(sBestMemBlockSize, CalculateBestMemoryBlockSize(m_sMinimalMemorySizeToAllocate));
-				AllocateMemory(sBestMemBlockSize);
+				return NULL;
 			}
 		}
 
@@ -68,7 +157,98 @@ namespace MemoryPool
 		m_uiObjectCount++;
 		SetMemoryChunkValues(ptrChunk, sBestMemBlockSize);
 
-		return ((void*)ptrChunk->Data);
+		//An allocation which is not sampled only counts down the per-thread byte countdown of the HeapProfiler
+		if ((m_ptrHeapProfiler) && (m_ptrHeapProfiler->ShouldSample(sMemorySize)))
+		{
+			ptrChunk->IsSampled = m_ptrHeapProfiler->RecordAllocation(((void*)ptrChunk->Data), sMemorySize);
+		}
+
+		return ptrChunk;
+	}
+
+	//
+	//GrowMemoryPool
+	//
+	MemoryChunk *MemoryPool::GrowMemoryPool(std::unique_lock<std::mutex> &lock, const std::size_t &sMemorySize)
+	{
+		if ((m_sHardLimit != NO_MEMORY_LIMIT) && (sMemorySize > m_sHardLimit))
+		{
+			return NULL;	//can never fit, don't wait for it
+		}
+
+		std::chrono::steady_clock::time_point tDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_uiWaitTimeout);
+		bool bPressureHandled = false;
+		MemoryChunk *ptrChunk = NULL;
+		while (!ptrChunk)
+		{
+			//The request itself keeps its size, only the new Segment is at least "m_sMinimalMemorySizeToAllocate" Bytes (if the hard limit allows it)
+			std::size_t sAllocationSize = MaxValue(sMemorySize, CalculateBestMemoryBlockSize(m_sMinimalMemorySizeToAllocate));
+			if (!IsWithinHardLimit(sAllocationSize))
+			{
+				sAllocationSize = sMemorySize;
+			}
+
+			bool bGrown = false;
+			if (ReuseSpareSegment(sMemorySize))
+			{
+				bGrown = true;	//A Segment returned by a child pool is used again (it is already counted in the size of the pool)
+			}
+			else if (IsWithinHardLimit(sAllocationSize))
+			{
+				//A child pool borrows its Segments from the parent pool instead of the OS
+				bool bAllocated = (m_ptrParentPool ? BorrowMemory(lock, sMemorySize, sAllocationSize) : AllocateMemory(sAllocationSize));
+				if (!bAllocated)
+				{
+					return NULL;	//The OS is out of memory (or the parent could not lend a Segment within its hard limit)
+				}
+				bGrown = true;
+			}
+			else if (!bPressureHandled)
+			{
+				//Give the callbacks a chance to free memory, before failing / waiting
+				bPressureHandled = true;
+				m_ePendingPressure = MEMORY_PRESSURE_HARD_LIMIT;
+				HandleMemoryPressure(lock);
+			}
+			else if ((m_eLimitPolicy == MEMORY_LIMIT_WAIT) && (std::chrono::steady_clock::now() < tDeadline))
+			{
+				m_uiWaitingThreads++;
+				m_cvMemoryFreed.wait_until(lock, tDeadline);
+				m_uiWaitingThreads--;
+			}
+			else
+			{
+				return NULL;
+			}
+
+			if (bGrown)
+			{
+				//The new Segment is the last one and completely free, the other Segments don't need to be searched again
+				ptrChunk = FindFreeChunksInSegment(m_ptrLastSegment, 0, sMemorySize);
+				if (ptrChunk)
+				{
+					m_ptrCursorSegment = m_ptrLastSegment;
+					m_ptrCursorChunk = ptrChunk;
+				}
+			}
+			else
+			{
+				ptrChunk = FindChunkSuitableToHoldMemory(sMemorySize);
+			}
+		}
+		return ptrChunk;
+	}
+
+	//
+	//IsWithinHardLimit
+	//
+	bool MemoryPool::IsWithinHardLimit(const std::size_t &sMemorySize) const
+	{
+		if (m_sHardLimit == NO_MEMORY_LIMIT)
+		{
+			return true;
+		}
+		return ((m_sTotalMemoryPoolSize <= m_sHardLimit) && (sMemorySize <= (m_sHardLimit - m_sTotalMemoryPoolSize)));
 	}
 
 	//
@@ -76,10 +256,12 @@ namespace MemoryPool
 	//
 	void MemoryPool::FreeMemory(void *ptrMemoryBlock, const std::size_t &sMemoryBlockSize)
 	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
 		//Search all Chunks for the one holding the "ptrMemoryBlock"-Pointer("SMemoryChunk->Data == ptrMemoryBlock"), so it beecomes available to the MemoryPool again.
 		MemoryChunk *ptrChunk = FindChunkHoldingPointerTo(ptrMemoryBlock);
 		if (ptrChunk)
 		{
+			assert((ptrChunk->Handle == INVALID_MEMORY_HANDLE) && "ERROR : Handle-Memory must be freed via FreeHandle()");
 			//std::cerr << "Freed Chunks OK (Used memPool Size : " << m_sUsedMemoryPoolSize << ")" << std::endl ;
 			FreeChunks(ptrChunk);
 		}
@@ -89,6 +271,7 @@ namespace MemoryPool
 		}
 		assert((m_uiObjectCount > 0) && "ERROR : Request to delete more Memory then allocated.");
 		m_uiObjectCount--;
+		NotifyWaitingThreads();
 	}
 
 	//
@@ -96,32 +279,123 @@ namespace MemoryPool
 	//
 	bool MemoryPool::AllocateMemory(const std::size_t &sMemorySize)
 	{
-		unsigned int uiNeedChunks = CalculateNeededChunks(sMemorySize);
+		MemorySegment *ptrNewSegment = CreateSegment(sMemorySize);
+		if (!ptrNewSegment)
+		{
+			return false;	//the System ran out of Memory, "GetMemory()" returns NULL
+		}
+		return AddSegment(ptrNewSegment);
+	}
+
+	//
+	//BorrowMemory
+	//
+	bool MemoryPool::BorrowMemory(std::unique_lock<std::mutex> &lock, const std::size_t &sMemorySize, const std::size_t &sPreferredSize)
+	{
+		MemoryPool *ptrPoolAtLimit = NULL;
+		MemorySegment *ptrNewSegment = m_ptrParentPool->LendSegment(sMemorySize, sPreferredSize, ptrPoolAtLimit);
+		m_bParentPressurePending = true;	//the parent may have crossed its soft limit, see "HandleMemoryPressure()"
+		if ((!ptrNewSegment) && (ptrPoolAtLimit))
+		{
+			//The parent (or one of its parents) is at its hard limit. It handles the loan like a request of its own (callbacks, trim,
+			//retry, wait), while the lock of this pool is released, so its callbacks can free memory of this pool.
+			lock.unlock();
+			ptrNewSegment = m_ptrParentPool->LendSegmentAtLimit(sMemorySize, sPreferredSize);
+			lock.lock();
+		}
+		if (!ptrNewSegment)
+		{
+			return false;	//the System ran out of Memory (or the parent stayed at its hard limit), "GetMemory()" returns NULL
+		}
+		return AddSegment(ptrNewSegment);
+	}
+
+	//
+	//AddSegment
+	//
+	bool MemoryPool::AddSegment(MemorySegment *ptrNewSegment)
+	{
+		IncreaseMemoryPoolSize(ptrNewSegment->DataSize);	//adjust internal values
+		m_sFreeMemoryPoolSize += ptrNewSegment->DataSize;
+		m_sMemoryChunkCount += ptrNewSegment->ChunkCount;
+		m_uiSegmentCount++;
+
+		return LinkChunksToData(ptrNewSegment);
+	}
+
+	//
+	//CreateSegment
+	//
+	MemorySegment *MemoryPool::CreateSegment(const std::size_t &sMemorySize)
+	{
+		std::size_t sNeedChunks = CalculateNeededChunks(sMemorySize);
 		std::size_t sBestMemBlockSize = CalculateBestMemoryBlockSize(sMemorySize);
+		if ((sBestMemBlockSize < sMemorySize) || (sNeedChunks > ((((std::size_t)-1) - sizeof(MemorySegment)) / sizeof(MemoryChunk))))
+		{
+			assert(false && "Error : Requested Memory size is too large");	//the sizes would wrap around
+			return NULL;
+		}
 
 		TByte *ptrNewMemBlock = (TByte*)malloc(sBestMemBlockSize); //allocate from the OS
-		MemoryChunk *ptrNewChunks = (MemoryChunk*)malloc((uiNeedChunks * sizeof(MemoryChunk)));	//allocate chunk array to manage the memory
-		assert(((ptrNewMemBlock) && (ptrNewChunks)) && "Error : System ran out of Memory");
+		MemorySegment *ptrNewSegment = (MemorySegment*)malloc(sizeof(MemorySegment) + (sNeedChunks * sizeof(MemoryChunk)));	//allocate the segment and its chunk array to manage the memory
+		if ((!ptrNewMemBlock) || (!ptrNewSegment))	//the System ran out of Memory
+		{
+			free(((void*)ptrNewMemBlock));
+			free(((void*)ptrNewSegment));
+			return NULL;
+		}
 
-		m_sTotalMemoryPoolSize += sBestMemBlockSize;	//adjust internal values
-		m_sFreeMemoryPoolSize += sBestMemBlockSize;
-		m_uiMemoryChunkCount += uiNeedChunks;
+		ptrNewSegment->Data = ptrNewMemBlock;
+		ptrNewSegment->DataSize = sBestMemBlockSize;
+		ptrNewSegment->Chunks = (MemoryChunk*)(ptrNewSegment + 1);	//the chunk array directly follows the segment
+		ptrNewSegment->ChunkCount = sNeedChunks;
+		ptrNewSegment->Next = NULL;
 
 		if (m_bSetMemoryData)
 		{
 			memset(((void*)ptrNewMemBlock), NEW_ALLOCATED_MEMORY_CONTENT, sBestMemBlockSize);	//set the memory content to a defined value is useful for debug
 		}
 
-		return LinkChunksToData(ptrNewChunks, uiNeedChunks, ptrNewMemBlock);
+		return ptrNewSegment;
+	}
+
+	//
+	//IncreaseMemoryPoolSize
+	//
+	void MemoryPool::IncreaseMemoryPoolSize(const std::size_t &sMemorySize)
+	{
+		if ((m_sSoftLimit != NO_MEMORY_LIMIT) && (m_sTotalMemoryPoolSize <= m_sSoftLimit) && ((m_sTotalMemoryPoolSize + sMemorySize) > m_sSoftLimit))
+		{
+			m_ePendingPressure = MEMORY_PRESSURE_SOFT_LIMIT;	//crossed the soft limit, see "HandleMemoryPressure()"
+		}
+		m_sTotalMemoryPoolSize += sMemorySize;
 	}
 
 	//
 	//CalculateNeededChunks
 	//
-	unsigned int MemoryPool::CalculateNeededChunks(const std::size_t &sMemorySize)
+	std::size_t MemoryPool::CalculateNeededChunks(const std::size_t &sMemorySize)
+	{
+		//Integer ceiling, written so it can't overflow for sizes near SIZE_MAX
+		if (m_uiMemoryChunkShift)
+		{
+			return ((sMemorySize >> m_uiMemoryChunkShift) + ((sMemorySize & m_sMemoryChunkMask) ? 1 : 0));
+		}
+		return ((sMemorySize / m_sMemoryChunkSize) + ((sMemorySize % m_sMemoryChunkSize) ? 1 : 0));
+	}
+
+	//
+	//CalculateChunkIndex
+	//
+	bool MemoryPool::CalculateChunkIndex(const std::size_t &sOffset, std::size_t &sChunkIndex)
 	{
-		float f = (float)(((float)sMemorySize) / ((float)m_sMemoryChunkSize));
-		return ((unsigned int)ceil(f));
+		if (m_uiMemoryChunkShift)
+		{
+			sChunkIndex = (sOffset >> m_uiMemoryChunkShift);
+			return ((sOffset & m_sMemoryChunkMask) == 0);
+		}
+		sChunkIndex = (sOffset / m_sMemoryChunkSize);
+		return ((sOffset % m_sMemoryChunkSize) == 0);
 	}
 
 	//
@@ -129,8 +403,12 @@ namespace MemoryPool
 	//
 	std::size_t MemoryPool::CalculateBestMemoryBlockSize(const std::size_t &sRequestedMemoryBlockSize)
 	{
-		unsigned int uiNeededChunks = CalculateNeededChunks(sRequestedMemoryBlockSize);
-		return std::size_t(uiNeededChunks * m_sMemoryChunkSize);
+		std::size_t sNeededChunks = CalculateNeededChunks(sRequestedMemoryBlockSize);
+		if (m_uiMemoryChunkShift)
+		{
+			return (sNeededChunks << m_uiMemoryChunkShift);
+		}
+		return (sNeededChunks * m_sMemoryChunkSize);
 	}
 
 	//
@@ -138,26 +416,26 @@ namespace MemoryPool
 	//
 	void MemoryPool::FreeChunks(MemoryChunk *ptrChunk)
 	{
-		//Make the Used Memory of the given Chunk available to the Memory Pool again.
-		MemoryChunk *ptrCurrentChunk = ptrChunk;
-		unsigned int uiChunkCount = CalculateNeededChunks(ptrCurrentChunk->UsedSize);
+		//Make the Used Memory of the given Chunk available to the Memory Pool again. Only the first Chunk of a block holds
+		//"UsedSize" / "Handle", the other Chunks of the block are free already, so they are not visited.
+		std::size_t sFreedSize = CalculateBestMemoryBlockSize(ptrChunk->UsedSize);
+		if (ptrChunk->IsSampled)
+		{
+			m_ptrHeapProfiler->RecordFree(((void*)ptrChunk->Data));
+			ptrChunk->IsSampled = false;
+		}
 
-		for (unsigned int i = 0; i < uiChunkCount; i++)
+		//Set the allocated Memory to 'FREEED_MEMORY_CONTENT' (Note : This is fully Optional, but usefull for debugging).
+		//The Chunks of a block are contiguous inside their Segment, so this is a single memset.
+		if (m_bSetMemoryData)
 		{
-			if (ptrCurrentChunk)
-			{
-				//Step 1 : Set the allocated Memory to 'FREEED_MEMORY_CONTENT' (Note : This is fully Optional, but usefull for debugging)
-				if (m_bSetMemoryData)
-				{
-					memset(((void*)ptrCurrentChunk->Data), FREEED_MEMORY_CONTENT, m_sMemoryChunkSize);
-				}
-				//Step 2 : Set the Used-Size to Zero
-				ptrCurrentChunk->UsedSize = 0;
-				//Step 3 : Adjust Memory-Pool Values and goto next Chunk
-				m_sUsedMemoryPoolSize -= m_sMemoryChunkSize;
-				ptrCurrentChunk = ptrCurrentChunk->Next;
-			}
+			memset(((void*)ptrChunk->Data), FREEED_MEMORY_CONTENT, sFreedSize);
 		}
+
+		ptrChunk->UsedSize = 0;
+		ptrChunk->Handle = INVALID_MEMORY_HANDLE;
+		m_sUsedMemoryPoolSize -= sFreedSize;
+		m_sFreeMemoryPoolSize += sFreedSize;
 	}
 
 	//
@@ -165,67 +443,91 @@ namespace MemoryPool
 	//
 	MemoryChunk *MemoryPool::FindChunkSuitableToHoldMemory(const std::size_t &sMemorySize)
 	{
-		//Find a Chunk to hold *at least* "sMemorySize" Bytes.
-		unsigned int uiChunksToSkip = 0;
-		bool bContinueSearch = true;
-		MemoryChunk *ptrChunk = m_ptrCursorChunk;	//start search at cursor pos
+		//Find a Chunk to hold *at least* "sMemorySize" Bytes. Start the search at the cursor pos, visit every following
+		//Segment and wrap around to the first one. The Cursor-Segment is searched again from its beginning at last.
+		MemorySegment *ptrSegment = m_ptrCursorSegment;
+		std::size_t sStartChunk = 0;
+		if (ptrSegment)
+		{
+			sStartChunk = (std::size_t)(m_ptrCursorChunk - ptrSegment->Chunks);
+		}
 
-		for (unsigned int i = 0; i < m_uiMemoryChunkCount; i++)
+		for (unsigned int i = 0; i <= m_uiSegmentCount; i++)
 		{
-			if (ptrChunk)
+			if (!ptrSegment)
 			{
-				if (ptrChunk == m_ptrLastChunk)	//end of list reached, start over from the beginning 
-				{
-					ptrChunk = m_ptrFirstChunk;
-				}
-
-				if (ptrChunk->DataSize >= sMemorySize)
-				{
-					if (ptrChunk->UsedSize == 0)
-					{
-						m_ptrCursorChunk = ptrChunk;
-						return ptrChunk;
-					}
-
-				}
-
-				uiChunksToSkip = CalculateNeededChunks(ptrChunk->UsedSize);
-				if (uiChunksToSkip == 0)
+				ptrSegment = m_ptrFirstSegment;	//end of list reached, start over from the beginning
+				if (!ptrSegment)
 				{
-					uiChunksToSkip = 1;
+					break;
 				}
-				ptrChunk = SkipChunks(ptrChunk, uiChunksToSkip);
 			}
-			else
+
+			MemoryChunk *ptrChunk = FindFreeChunksInSegment(ptrSegment, sStartChunk, sMemorySize);
+			if (ptrChunk)
 			{
-				bContinueSearch = false;
+				m_ptrCursorSegment = ptrSegment;
+				m_ptrCursorChunk = ptrChunk;
+				return ptrChunk;
 			}
+
+			ptrSegment = ptrSegment->Next;
+			sStartChunk = 0;
 		}
 
 		return NULL;
 	}
 
 	//
-	//SkipChunks
+	//FindFreeChunksInSegment
 	//
-	MemoryChunk *MemoryPool::SkipChunks(MemoryChunk *ptrStartChunk, unsigned int uiChunksToSkip)
+	MemoryChunk *MemoryPool::FindFreeChunksInSegment(MemorySegment *ptrSegment, std::size_t sStartChunk, const std::size_t &sMemorySize)
 	{
-		MemoryChunk *ptrCurrentChunk = ptrStartChunk;
-		for (unsigned int i = 0; i < uiChunksToSkip; i++)
+		//"sStartChunk" has to be the first Chunk of a used or free block. Used blocks are skipped as a whole, only the first
+		//Chunk of a used block holds its "UsedSize". All Chunks after the high-water mark are free.
+		std::size_t sNeededChunks = MaxValue(CalculateNeededChunks(sMemorySize), 1);	//even an empty block needs a Chunk to point to
+		std::size_t sInitializedChunks = ptrSegment->InitializedChunks;
+		std::size_t i = sStartChunk;
+		while (i < ptrSegment->ChunkCount)
 		{
-			if (ptrCurrentChunk)
+			if (i >= sInitializedChunks)
+			{
+				if ((ptrSegment->ChunkCount - i) < sNeededChunks)
+				{
+					break;	//not enough memory left in this Segment
+				}
+				InitializeChunks(ptrSegment, i + sNeededChunks);
+				return &(ptrSegment->Chunks[i]);
+			}
+
+			MemoryChunk *ptrChunk = &(ptrSegment->Chunks[i]);
+			if (ptrChunk->DataSize < sMemorySize)
+			{
+				break;	//not enough memory left in this Segment
+			}
+
+			if (ptrChunk->UsedSize == 0)
 			{
-				ptrCurrentChunk = ptrCurrentChunk->Next;
+				std::size_t sFreeChunks = 1;
+				while ((sFreeChunks < sNeededChunks) && (((i + sFreeChunks) >= sInitializedChunks) || (ptrSegment->Chunks[i + sFreeChunks].UsedSize == 0)))
+				{
+					sFreeChunks++;
+				}
+
+				if (sFreeChunks == sNeededChunks)
+				{
+					InitializeChunks(ptrSegment, i + sNeededChunks);
+					return ptrChunk;
+				}
+				i += sFreeChunks;
 			}
 			else
 			{
-				//Will occur, if you try to Skip more Chunks than actually available from your "ptrStartChunk" 
-				assert(false && "Error : Chunk == NULL was not expected.");
-				break;
+				i += CalculateNeededChunks(ptrChunk->UsedSize);
 			}
 		}
 
-		return ptrCurrentChunk;
+		return NULL;
 	}
 
 	//
@@ -248,20 +550,21 @@ namespace MemoryPool
 	//
 	bool MemoryPool::WriteMemoryDumpToFile(const std::string &strFileName)
 	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
 		bool bWriteSuccesfull = false;
 		std::ofstream ofOutPutFile;
 		ofOutPutFile.open(strFileName.c_str(), std::ofstream::out | std::ofstream::binary);
 
-		MemoryChunk *ptrCurrentChunk = m_ptrFirstChunk;
+		MemorySegment *ptrCurrentSegment = m_ptrFirstSegment;
 
-		while (ptrCurrentChunk)
+		while (ptrCurrentSegment)
 		{
 			if (ofOutPutFile.good())
 			{
-				ofOutPutFile.write(((char*)ptrCurrentChunk->Data), ((std::streamsize)m_sMemoryChunkSize));
+				ofOutPutFile.write(((char*)ptrCurrentSegment->Data), ((std::streamsize)ptrCurrentSegment->DataSize));
 				bWriteSuccesfull = true;
 			}
-			ptrCurrentChunk = ptrCurrentChunk->Next;
+			ptrCurrentSegment = ptrCurrentSegment->Next;
 		}
 		ofOutPutFile.close();
 		return bWriteSuccesfull;
@@ -270,63 +573,44 @@ namespace MemoryPool
 	//
 	//LinkChunksToData
 	//
-	bool MemoryPool::LinkChunksToData(MemoryChunk *ptrNewChunks, unsigned int uiChunkCount, TByte *ptrNewMemBlock)
+	bool MemoryPool::LinkChunksToData(MemorySegment *ptrNewSegment)
 	{
-		MemoryChunk *ptrNewChunk = NULL;
-		unsigned int uiMemOffset = 0;
-		bool bAllocationChunkAssigned = false;
-		for (unsigned int i = 0; i < uiChunkCount; i++)
-		{
-			if (!m_ptrFirstChunk)
-			{
-				m_ptrFirstChunk = SetChunkDefaults(&(ptrNewChunks[0]));
-				m_ptrLastChunk = m_ptrFirstChunk;
-				m_ptrCursorChunk = m_ptrFirstChunk;
-			}
-			else
-			{
-				ptrNewChunk = SetChunkDefaults(&(ptrNewChunks[i]));
-				m_ptrLastChunk->Next = ptrNewChunk;
-				m_ptrLastChunk = ptrNewChunk;
-			}
+		//The Chunks are not touched here. A large Segment would need millions of writes (and pages) for its Chunk-Array,
+		//so the Chunks are initialized when the Memory they manage is handed out for the first time.
+		ptrNewSegment->InitializedChunks = 0;
 
-			uiMemOffset = (i * ((unsigned int)m_sMemoryChunkSize));
-			m_ptrLastChunk->Data = &(ptrNewMemBlock[uiMemOffset]);
-			
-			//The first Chunk assigned to the new Memory-Block will be a "AllocationChunk".This means, this Chunks stores the
-			//"original" Pointer to the MemBlock and is responsible for "free()"ing the Memory later
-			if (!bAllocationChunkAssigned)
-			{
-				m_ptrLastChunk->IsAllocationChunk = true;
-				bAllocationChunkAssigned = true;
-			}
+		if (!m_ptrFirstSegment)
+		{
+			m_ptrFirstSegment = ptrNewSegment;
+			m_ptrCursorSegment = ptrNewSegment;
+			m_ptrCursorChunk = ptrNewSegment->Chunks;
+		}
+		else
+		{
+			m_ptrLastSegment->Next = ptrNewSegment;
 		}
+		m_ptrLastSegment = ptrNewSegment;
 
-		return RecalcChunkMemorySize(m_ptrFirstChunk, m_uiMemoryChunkCount);
+		return true;
 	}
 
 	//
-	//RecalcChunkMemorySize
+	//InitializeChunks
 	//
-	bool MemoryPool::RecalcChunkMemorySize(MemoryChunk *ptrChunk, unsigned int uiChunkCount)
+	void MemoryPool::InitializeChunks(MemorySegment *ptrSegment, std::size_t sChunkCount)
 	{
-		unsigned int uiMemoryOffSet = 0;
-		for (unsigned int i = 0; i < uiChunkCount; i++)
+		MemoryChunk *ptrChunks = ptrSegment->Chunks;
+		for (std::size_t i = ptrSegment->InitializedChunks; i < sChunkCount; i++)
 		{
-			if (ptrChunk)
-			{
-				uiMemoryOffSet = (i * ((unsigned int)m_sMemoryChunkSize));
-				ptrChunk->DataSize = (((unsigned int)m_sTotalMemoryPoolSize) - uiMemoryOffSet);
-				ptrChunk = ptrChunk->Next;
-			}
-			else
-			{
-				assert(false && "Error : ptrChunk == NULL");
-				return false;
-			}
+			SetChunkDefaults(&(ptrChunks[i]));
+			ptrChunks[i].Data = &(ptrSegment->Data[i * m_sMemoryChunkSize]);
+			ptrChunks[i].DataSize = ((ptrSegment->ChunkCount - i) * m_sMemoryChunkSize);	//Memory of different Segments is not contiguous, so this is the memory left until the end of the Segment
 		}
 
-		return true;
+		if (sChunkCount > ptrSegment->InitializedChunks)
+		{
+			ptrSegment->InitializedChunks = sChunkCount;
+		}
 	}
 
 	//
@@ -339,8 +623,8 @@ namespace MemoryPool
 			ptrChunk->Data = NULL;
 			ptrChunk->DataSize = 0;
 			ptrChunk->UsedSize = 0;
-			ptrChunk->IsAllocationChunk = false;
-			ptrChunk->Next = NULL;
+			ptrChunk->IsSampled = false;
+			ptrChunk->Handle = INVALID_MEMORY_HANDLE;
 		}
 
 		return ptrChunk;
@@ -351,17 +635,37 @@ namespace MemoryPool
 	//
 	MemoryChunk *MemoryPool::FindChunkHoldingPointerTo(void *ptrMemoryBlock)
 	{
-		MemoryChunk *ptrTempChunk = m_ptrFirstChunk;
-		while (ptrTempChunk)
+		//The Chunks of a Segment are an array, so only the Segment has to be searched
+		MemorySegment *ptrSegment = FindSegmentHoldingPointerTo(ptrMemoryBlock);
+		if (ptrSegment)
+		{
+			std::size_t sChunkIndex = 0;
+			if (CalculateChunkIndex((std::size_t)(((TByte*)ptrMemoryBlock) - ptrSegment->Data), sChunkIndex) && (sChunkIndex < ptrSegment->InitializedChunks))
+			{
+				return &(ptrSegment->Chunks[sChunkIndex]);
+			}
+		}
+
+		return NULL;
+	}
+
+	//
+	//FindSegmentHoldingPointerTo
+	//
+	MemorySegment *MemoryPool::FindSegmentHoldingPointerTo(void *ptrMemoryBlock)
+	{
+		TByte *ptrData = (TByte*)ptrMemoryBlock;
+		MemorySegment *ptrTempSegment = m_ptrFirstSegment;
+		while (ptrTempSegment)
 		{
-			if (ptrTempChunk->Data == ((TByte*)ptrMemoryBlock))
+			if ((ptrData >= ptrTempSegment->Data) && (ptrData < (ptrTempSegment->Data + ptrTempSegment->DataSize)))
 			{
 				break;
 			}
-			ptrTempChunk = ptrTempChunk->Next;
+			ptrTempSegment = ptrTempSegment->Next;
 		}
 
-		return ptrTempChunk;
+		return ptrTempSegment;
 	}
 
 	//
@@ -369,14 +673,11 @@ namespace MemoryPool
 	//
 	void MemoryPool::FreeAllAllocatedMemory()
 	{
-		MemoryChunk *ptrChunk = m_ptrFirstChunk;
-		while (ptrChunk)
+		MemorySegment *ptrSegment = m_ptrFirstSegment;
+		while (ptrSegment)
 		{
-			if (ptrChunk->IsAllocationChunk)
-			{
-				free(((void*)(ptrChunk->Data)));
-			}
-			ptrChunk = ptrChunk->Next;
+			free(((void*)(ptrSegment->Data)));
+			ptrSegment = ptrSegment->Next;
 		}
 	}
 
@@ -385,21 +686,21 @@ namespace MemoryPool
 	//
 	void MemoryPool::DeallocateAllChunks()
 	{
-		MemoryChunk *ptrChunk = m_ptrFirstChunk;
-		MemoryChunk *ptrChunkToDelete = NULL;
+		//The chunk array of a Segment is allocated together with the Segment
+		MemorySegment *ptrSegment = m_ptrFirstSegment;
+		MemorySegment *ptrSegmentToDelete = NULL;
 
-		while (ptrChunk)
+		while (ptrSegment)
 		{
-			if (ptrChunk->IsAllocationChunk)
-			{
-				if (ptrChunkToDelete)
-				{
-					free(((void*)ptrChunkToDelete));
-				}
-				ptrChunkToDelete = ptrChunk;
-			}
-			ptrChunk = ptrChunk->Next;
+			ptrSegmentToDelete = ptrSegment;
+			ptrSegment = ptrSegment->Next;
+			free(((void*)ptrSegmentToDelete));
 		}
+
+		m_ptrFirstSegment = NULL;
+		m_ptrLastSegment = NULL;
+		m_ptrCursorSegment = NULL;
+		m_ptrCursorChunk = NULL;
 	}
 
 	//
@@ -407,16 +708,11 @@ namespace MemoryPool
 	//
 	bool MemoryPool::IsValidPointer(void *ptrPointer)
 	{
-		MemoryChunk *ptrChunk = m_ptrFirstChunk;
-		while (ptrChunk)
-		{
-			if (ptrChunk->Data == ((TByte*)ptrPointer))
-			{
-				return true;
-			}
-			ptrChunk = ptrChunk->Next;
-		}
-		return false;
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		//Chunks after the high-water mark are not initialized, but their "Data" would still point into the Segment
+		MemorySegment *ptrSegment = FindSegmentHoldingPointerTo(ptrPointer);
+		std::size_t sChunkIndex = 0;
+		return ((ptrSegment) && CalculateChunkIndex((std::size_t)(((TByte*)ptrPointer) - ptrSegment->Data), sChunkIndex));
 	}
 
 	//
@@ -432,4 +728,878 @@ namespace MemoryPool
 	}
 
 
+
+	//
+	//GetHandle
+	//
+	MemoryHandle MemoryPool::GetHandle(const std::size_t &sMemorySize)
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		MemoryHandle hMemory = AcquireHandleEntry();
+		if (hMemory == INVALID_MEMORY_HANDLE)
+		{
+			return INVALID_MEMORY_HANDLE;
+		}
+
+		MemoryHandleEntry *ptrEntry = &(m_ptrHandles[hMemory]);
+		ptrEntry->Chunk = NULL;	//the entry is unused until the memory has been found
+		MemoryChunk *ptrChunk = GetChunks(lock, sMemorySize);
+		ptrEntry = &(m_ptrHandles[hMemory]);	//the table may have grown, while the lock was released
+		if (!ptrChunk)
+		{
+			ptrEntry->NextFree = m_uiFreeHandle;	//put the entry back on the free list
+			m_uiFreeHandle = hMemory;
+			HandleMemoryPressure(lock);
+			return INVALID_MEMORY_HANDLE;
+		}
+
+		ptrChunk->Handle = hMemory;
+		ptrEntry->Chunk = ptrChunk;
+		ptrEntry->PinCount = 0;
+		ptrEntry->NextFree = 0;
+
+		HandleMemoryPressure(lock);	//the soft limit may have been crossed
+		return hMemory;
+	}
+
+	//
+	//FreeHandle
+	//
+	void MemoryPool::FreeHandle(MemoryHandle hMemory)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if ((hMemory == INVALID_MEMORY_HANDLE) || (hMemory >= m_uiHandleCount) || (!m_ptrHandles[hMemory].Chunk))
+		{
+			assert(false && "ERROR : Invalid Handle");
+			return;
+		}
+
+		MemoryHandleEntry *ptrEntry = &(m_ptrHandles[hMemory]);
+		assert((ptrEntry->PinCount == 0) && "ERROR : Request to free a pinned Handle");
+		FreeChunks(ptrEntry->Chunk);
+
+		ptrEntry->Chunk = NULL;	//put the entry on the free list
+		ptrEntry->PinCount = 0;
+		ptrEntry->NextFree = m_uiFreeHandle;
+		m_uiFreeHandle = hMemory;
+
+		assert((m_uiObjectCount > 0) && "ERROR : Request to delete more Memory then allocated.");
+		m_uiObjectCount--;
+		NotifyWaitingThreads();
+	}
+
+	//
+	//PinHandle
+	//
+	void *MemoryPool::PinHandle(MemoryHandle hMemory)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if ((hMemory == INVALID_MEMORY_HANDLE) || (hMemory >= m_uiHandleCount) || (!m_ptrHandles[hMemory].Chunk))
+		{
+			assert(false && "ERROR : Invalid Handle");
+			return NULL;
+		}
+
+		m_ptrHandles[hMemory].PinCount++;
+		return ((void*)m_ptrHandles[hMemory].Chunk->Data);
+	}
+
+	//
+	//UnpinHandle
+	//
+	void MemoryPool::UnpinHandle(MemoryHandle hMemory)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if ((hMemory == INVALID_MEMORY_HANDLE) || (hMemory >= m_uiHandleCount) || (!m_ptrHandles[hMemory].Chunk))
+		{
+			assert(false && "ERROR : Invalid Handle");
+			return;
+		}
+
+		assert((m_ptrHandles[hMemory].PinCount > 0) && "ERROR : Request to unpin a Handle which is not pinned");
+		m_ptrHandles[hMemory].PinCount--;
+	}
+
+	//
+	//AcquireHandleEntry
+	//
+	MemoryHandle MemoryPool::AcquireHandleEntry()
+	{
+		if (m_uiFreeHandle != 0)
+		{
+			MemoryHandle hMemory = m_uiFreeHandle;
+			m_uiFreeHandle = m_ptrHandles[hMemory].NextFree;
+			return hMemory;
+		}
+
+		if (m_uiHandleCount >= m_uiHandleCapacity)
+		{
+			//Grow the handle table. The entries are only referenced by index, so they can be moved by "realloc()"
+			unsigned int uiNewCapacity = (unsigned int)MaxValue(m_uiHandleCapacity * 2, 64);
+			MemoryHandleEntry *ptrNewHandles = (MemoryHandleEntry*)realloc(((void*)m_ptrHandles), (uiNewCapacity * sizeof(MemoryHandleEntry)));
+			assert(ptrNewHandles && "Error : System ran out of Memory");
+			if (!ptrNewHandles)
+			{
+				return INVALID_MEMORY_HANDLE;
+			}
+			m_ptrHandles = ptrNewHandles;
+			m_uiHandleCapacity = uiNewCapacity;
+		}
+
+		return m_uiHandleCount++;
+	}
+
+	//
+	//Compact
+	//
+	CompactionStats MemoryPool::Compact(const std::size_t &sBudget)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		CompactionStats stats;
+		stats.BytesMoved = 0;
+		stats.BytesReleased = 0;
+		stats.SegmentsReleased = 0;
+		stats.FragmentationBefore = CalculateFragmentation();
+
+		//Step 1 : Empty the Segments at the end of the list, by moving their memory into the free Chunks of the Segments before them.
+		//The list is singly linked, so remember the Segments in an array to walk it backwards.
+		MemorySegment **ptrSegments = NULL;
+		if (m_uiSegmentCount > 1)
+		{
+			ptrSegments = (MemorySegment**)malloc(m_uiSegmentCount * sizeof(MemorySegment*));
+		}
+		if (ptrSegments)
+		{
+			unsigned int uiSegment = 0;
+			for (MemorySegment *ptrSegment = m_ptrFirstSegment; ptrSegment; ptrSegment = ptrSegment->Next)
+			{
+				ptrSegments[uiSegment++] = ptrSegment;
+			}
+
+			for (unsigned int i = m_uiSegmentCount - 1; i > 0; i--)
+			{
+				if (stats.BytesMoved >= sBudget)
+				{
+					break;
+				}
+				EvacuateSegment(ptrSegments[i], ptrSegments[i], sBudget, stats.BytesMoved);
+			}
+			free(((void*)ptrSegments));
+		}
+
+		//Step 2 : Slide the remaining memory to the front of each Segment, so the free memory of a Segment is one block.
+		for (MemorySegment *ptrSegment = m_ptrFirstSegment; ptrSegment; ptrSegment = ptrSegment->Next)
+		{
+			SlideSegment(ptrSegment, sBudget, stats.BytesMoved);
+		}
+
+		//Step 3 : Give the Segments which became unused back to the OS.
+		ReleaseUnusedSegments(stats.BytesReleased, stats.SegmentsReleased);
+
+		//Chunks may have been moved or released, so the Cursor has to point to the beginning of a block again
+		m_ptrCursorSegment = m_ptrFirstSegment;
+		m_ptrCursorChunk = (m_ptrFirstSegment ? m_ptrFirstSegment->Chunks : NULL);
+
+		stats.FragmentationAfter = CalculateFragmentation();
+		NotifyWaitingThreads();	//the pool may have shrunk below the hard limit
+		return stats;
+	}
+
+	//
+	//IsMovable
+	//
+	bool MemoryPool::IsMovable(MemoryChunk *ptrChunk) const
+	{
+		return ((ptrChunk->Handle != INVALID_MEMORY_HANDLE) && (m_ptrHandles[ptrChunk->Handle].PinCount == 0));
+	}
+
+	//
+	//MoveChunks
+	//
+	void MemoryPool::MoveChunks(MemoryChunk *ptrSourceChunk, MemoryChunk *ptrDestinationChunk)
+	{
+		std::size_t sUsedSize = ptrSourceChunk->UsedSize;
+		MemoryHandle hMemory = ptrSourceChunk->Handle;
+
+		//Source and destination may overlap, when the memory is moved inside of a Segment
+		memmove(((void*)ptrDestinationChunk->Data), ((void*)ptrSourceChunk->Data), sUsedSize);
+		if (m_bSetMemoryData)
+		{
+			TByte *ptrFreed = ptrSourceChunk->Data;
+			if ((ptrDestinationChunk->Data < ptrSourceChunk->Data) && ((ptrDestinationChunk->Data + sUsedSize) > ptrSourceChunk->Data))
+			{
+				ptrFreed = ptrDestinationChunk->Data + sUsedSize;
+			}
+			memset(((void*)ptrFreed), FREEED_MEMORY_CONTENT, (std::size_t)((ptrSourceChunk->Data + sUsedSize) - ptrFreed));
+		}
+
+		//Only the first Chunk of a block holds the "UsedSize", so the rest of the old Chunks are free already
+		if (ptrSourceChunk->IsSampled)
+		{
+			m_ptrHeapProfiler->RecordMove(((void*)ptrSourceChunk->Data), ((void*)ptrDestinationChunk->Data));
+		}
+		ptrDestinationChunk->IsSampled = ptrSourceChunk->IsSampled;
+		ptrSourceChunk->IsSampled = false;
+
+		ptrSourceChunk->UsedSize = 0;
+		ptrSourceChunk->Handle = INVALID_MEMORY_HANDLE;
+		ptrDestinationChunk->UsedSize = sUsedSize;
+		ptrDestinationChunk->Handle = hMemory;
+		m_ptrHandles[hMemory].Chunk = ptrDestinationChunk;
+	}
+
+	//
+	//EvacuateSegment
+	//
+	bool MemoryPool::EvacuateSegment(MemorySegment *ptrSegment, MemorySegment *ptrSegmentEnd, const std::size_t &sBudget, std::size_t &sBytesMoved)
+	{
+		//Only try it, if the whole Segment can become unused
+		std::size_t sUsedSize = 0;
+		std::size_t i = 0;
+		while (i < ptrSegment->InitializedChunks)
+		{
+			MemoryChunk *ptrChunk = &(ptrSegment->Chunks[i]);
+			if (ptrChunk->UsedSize == 0)
+			{
+				i++;
+				continue;
+			}
+			if (!IsMovable(ptrChunk))
+			{
+				return false;
+			}
+			sUsedSize += ptrChunk->UsedSize;
+			i += CalculateNeededChunks(ptrChunk->UsedSize);
+		}
+		if ((sBytesMoved + sUsedSize) > sBudget)
+		{
+			return false;
+		}
+
+		i = 0;
+		while (i < ptrSegment->InitializedChunks)
+		{
+			MemoryChunk *ptrChunk = &(ptrSegment->Chunks[i]);
+			if (ptrChunk->UsedSize == 0)
+			{
+				i++;
+				continue;
+			}
+
+			std::size_t sChunkUsedSize = ptrChunk->UsedSize;
+			MemoryChunk *ptrDestinationChunk = NULL;
+			for (MemorySegment *ptrDestinationSegment = m_ptrFirstSegment; (ptrDestinationSegment != ptrSegmentEnd) && (!ptrDestinationChunk); ptrDestinationSegment = ptrDestinationSegment->Next)
+			{
+				ptrDestinationChunk = FindFreeChunksInSegment(ptrDestinationSegment, 0, sChunkUsedSize);
+			}
+			if (!ptrDestinationChunk)
+			{
+				return false;	//the other Segments are full
+			}
+
+			MoveChunks(ptrChunk, ptrDestinationChunk);
+			sBytesMoved += sChunkUsedSize;
+			i += CalculateNeededChunks(sChunkUsedSize);
+		}
+
+		return true;
+	}
+
+	//
+	//SlideSegment
+	//
+	void MemoryPool::SlideSegment(MemorySegment *ptrSegment, const std::size_t &sBudget, std::size_t &sBytesMoved)
+	{
+		std::size_t sFirstFreeChunk = 0;	//everything before this Chunk is used (or can't be moved)
+		std::size_t i = 0;
+		while (i < ptrSegment->InitializedChunks)
+		{
+			MemoryChunk *ptrChunk = &(ptrSegment->Chunks[i]);
+			if (ptrChunk->UsedSize == 0)
+			{
+				i++;
+				continue;
+			}
+
+			std::size_t sChunkUsedSize = ptrChunk->UsedSize;
+			std::size_t sChunks = CalculateNeededChunks(sChunkUsedSize);
+			if ((sFirstFreeChunk != i) && IsMovable(ptrChunk) && ((sBytesMoved + sChunkUsedSize) <= sBudget))
+			{
+				MoveChunks(ptrChunk, &(ptrSegment->Chunks[sFirstFreeChunk]));
+				sBytesMoved += sChunkUsedSize;
+				sFirstFreeChunk += sChunks;
+			}
+			else
+			{
+				sFirstFreeChunk = i + sChunks;
+			}
+			i += sChunks;
+		}
+	}
+
+	//
+	//IsSegmentUnused
+	//
+	bool MemoryPool::IsSegmentUnused(MemorySegment *ptrSegment) const
+	{
+		for (std::size_t i = 0; i < ptrSegment->InitializedChunks; i++)
+		{
+			if (ptrSegment->Chunks[i].UsedSize != 0)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	//
+	//ReleaseSegment
+	//
+	void MemoryPool::ReleaseSegment(MemorySegment *ptrSegment, MemorySegment *ptrPreviousSegment)
+	{
+		if (ptrPreviousSegment)
+		{
+			ptrPreviousSegment->Next = ptrSegment->Next;
+		}
+		else
+		{
+			m_ptrFirstSegment = ptrSegment->Next;
+		}
+		if (m_ptrLastSegment == ptrSegment)
+		{
+			m_ptrLastSegment = ptrPreviousSegment;
+		}
+		if (m_ptrCursorSegment == ptrSegment)
+		{
+			m_ptrCursorSegment = m_ptrFirstSegment;
+			m_ptrCursorChunk = (m_ptrFirstSegment ? m_ptrFirstSegment->Chunks : NULL);
+		}
+
+		m_sTotalMemoryPoolSize -= ptrSegment->DataSize;	//adjust internal values
+		m_sFreeMemoryPoolSize -= ptrSegment->DataSize;
+		m_sMemoryChunkCount -= ptrSegment->ChunkCount;
+		m_uiSegmentCount--;
+
+		ptrSegment->Next = NULL;
+		FreeSegments(ptrSegment, ptrSegment);
+	}
+
+	//
+	//ReleaseUnusedSegments
+	//
+	void MemoryPool::ReleaseUnusedSegments(std::size_t &sBytesReleased, unsigned int &uiSegmentsReleased)
+	{
+		ReleaseSpareSegments(sBytesReleased, uiSegmentsReleased);
+
+		//The first Segment (the initial pool) is always kept.
+		MemorySegment *ptrPreviousSegment = m_ptrFirstSegment;
+		MemorySegment *ptrSegment = (m_ptrFirstSegment ? m_ptrFirstSegment->Next : NULL);
+		while (ptrSegment)
+		{
+			MemorySegment *ptrNextSegment = ptrSegment->Next;
+			if (IsSegmentUnused(ptrSegment))
+			{
+				sBytesReleased += ptrSegment->DataSize;
+				uiSegmentsReleased++;
+				ReleaseSegment(ptrSegment, ptrPreviousSegment);
+			}
+			else
+			{
+				ptrPreviousSegment = ptrSegment;
+			}
+			ptrSegment = ptrNextSegment;
+		}
+	}
+
+	//
+	//CalculateFragmentation
+	//
+	double MemoryPool::CalculateFragmentation()
+	{
+		std::size_t sTotalFree = 0;
+		std::size_t sLargestFree = 0;
+		for (MemorySegment *ptrSegment = m_ptrFirstSegment; ptrSegment; ptrSegment = ptrSegment->Next)
+		{
+			std::size_t sFree = 0;	//size of the current free block
+			for (std::size_t i = 0; i < ptrSegment->InitializedChunks; i++)
+			{
+				if (ptrSegment->Chunks[i].UsedSize == 0)
+				{
+					sFree += m_sMemoryChunkSize;
+					continue;
+				}
+				sTotalFree += sFree;
+				sLargestFree = MaxValue(sLargestFree, sFree);
+				sFree = 0;
+				i += CalculateNeededChunks(ptrSegment->Chunks[i].UsedSize) - 1;
+			}
+			sFree += ((ptrSegment->ChunkCount - ptrSegment->InitializedChunks) * m_sMemoryChunkSize);	//the Chunks after the high-water mark are free
+			sTotalFree += sFree;
+			sLargestFree = MaxValue(sLargestFree, sFree);
+		}
+
+		if (sTotalFree == 0)
+		{
+			return 0.0;
+		}
+		return (1.0 - ((double)sLargestFree / (double)sTotalFree));
+	}
+
+
+	//
+	//EnableHeapProfiler
+	//
+	void MemoryPool::EnableHeapProfiler(const std::size_t &sSampleInterval, const std::string &strLeakReportFileName)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (!m_ptrHeapProfiler)
+		{
+			m_ptrHeapProfiler = new HeapProfiler(sSampleInterval);
+		}
+		m_strLeakReportFileName = strLeakReportFileName;
+	}
+
+	//
+	//DumpHeapProfile
+	//
+	bool MemoryPool::DumpHeapProfile(const std::string &strFileName)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);	//the samples are changed by every "GetMemory()" / "FreeMemory()"
+		return WriteHeapProfile(strFileName);
+	}
+
+	//
+	//WriteHeapProfile
+	//
+	bool MemoryPool::WriteHeapProfile(const std::string &strFileName)
+	{
+		if (!m_ptrHeapProfiler)
+		{
+			return false;
+		}
+
+		std::ofstream ofOutPutFile;
+		ofOutPutFile.open(strFileName.c_str(), std::ofstream::out);
+		bool bWriteSuccesfull = (ofOutPutFile.good() && m_ptrHeapProfiler->WriteProfile(ofOutPutFile));
+		ofOutPutFile.close();
+		return bWriteSuccesfull;
+	}
+
+	//
+	//WriteLeakReport
+	//
+	void MemoryPool::WriteLeakReport()
+	{
+		std::size_t sLeakedBytes = 0;
+		std::size_t sLeakedSamples = m_ptrHeapProfiler->GetLiveSamples(sLeakedBytes);
+		std::cerr << "WARNING : Memory-Leak : " << m_uiObjectCount << " Objects (" << m_sUsedMemoryPoolSize << " Bytes) not freed, " 
+			<< sLeakedSamples << " of them sampled (" << sLeakedBytes << " Bytes)";
+
+		if (m_strLeakReportFileName.empty())
+		{
+			std::cerr << ":" << std::endl;
+			m_ptrHeapProfiler->WriteProfile(std::cerr);
+		}
+		else if (WriteHeapProfile(m_strLeakReportFileName))
+		{
+			std::cerr << ", see \"" << m_strLeakReportFileName << "\"" << std::endl;
+		}
+		else
+		{
+			std::cerr << ", could not write \"" << m_strLeakReportFileName << "\"" << std::endl;
+		}
+	}
+
+
+	//
+	//SetMemoryLimits
+	//
+	void MemoryPool::SetMemoryLimits(const std::size_t &sSoftLimit, const std::size_t &sHardLimit, MemoryLimitPolicy ePolicy, unsigned int uiWaitTimeout)
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_sSoftLimit = sSoftLimit;
+		m_sHardLimit = sHardLimit;
+		m_eLimitPolicy = ePolicy;
+		m_uiWaitTimeout = uiWaitTimeout;
+		if ((m_sSoftLimit != NO_MEMORY_LIMIT) && (m_sTotalMemoryPoolSize > m_sSoftLimit))
+		{
+			m_ePendingPressure = MEMORY_PRESSURE_SOFT_LIMIT;	//already beyond the new soft limit
+		}
+		HandleMemoryPressure(lock);
+		NotifyWaitingThreads();	//a raised hard limit may let waiting requests grow the pool
+	}
+
+	//
+	//AddMemoryPressureCallback
+	//
+	void MemoryPool::AddMemoryPressureCallback(MemoryPressureCallback fnCallback, void *ptrUserData)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		MemoryPressureCallbackEntry entry;
+		entry.Callback = fnCallback;
+		entry.UserData = ptrUserData;
+		m_PressureCallbacks.push_back(entry);
+	}
+
+	//
+	//RemoveMemoryPressureCallback
+	//
+	void MemoryPool::RemoveMemoryPressureCallback(MemoryPressureCallback fnCallback, void *ptrUserData)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		for (std::size_t i = 0; i < m_PressureCallbacks.size(); i++)
+		{
+			if ((m_PressureCallbacks[i].Callback == fnCallback) && (m_PressureCallbacks[i].UserData == ptrUserData))
+			{
+				m_PressureCallbacks.erase(m_PressureCallbacks.begin() + i);
+				return;
+			}
+		}
+	}
+
+	//
+	//HandleMemoryPressure
+	//
+	void MemoryPool::HandleMemoryPressure(std::unique_lock<std::mutex> &lock)
+	{
+		if (m_bParentPressurePending)
+		{
+			//Borrowing Segments may have pushed the parent beyond its limits. Its callbacks are called only now, with the lock
+			//of this pool released, so they can free memory of this pool without a deadlock (see "LendSegment()").
+			m_bParentPressurePending = false;
+			lock.unlock();
+			m_ptrParentPool->HandlePendingMemoryPressure();
+			lock.lock();
+		}
+
+		if (m_ePendingPressure == MEMORY_PRESSURE_NONE)
+		{
+			return;
+		}
+
+		//The callbacks may free memory of this pool, so they are called without holding the lock. A copy of the
+		//list is used, in case a callback is (un)registered meanwhile.
+		MemoryPressureLevel ePressureLevel = m_ePendingPressure;
+		m_ePendingPressure = MEMORY_PRESSURE_NONE;
+		std::vector<MemoryPressureCallbackEntry> callbacks(m_PressureCallbacks);
+		std::size_t sMemoryPoolSize = m_sTotalMemoryPoolSize;
+		lock.unlock();
+		for (std::size_t i = 0; i < callbacks.size(); i++)
+		{
+			callbacks[i].Callback(this, ePressureLevel, sMemoryPoolSize, callbacks[i].UserData);
+		}
+		lock.lock();
+
+		std::size_t sBytesReleased = 0;
+		unsigned int uiSegmentsReleased = 0;
+		ReleaseUnusedSegments(sBytesReleased, uiSegmentsReleased);
+		if (sBytesReleased)
+		{
+			NotifyWaitingThreads();
+		}
+	}
+
+	//
+	//HandlePendingMemoryPressure
+	//
+	void MemoryPool::HandlePendingMemoryPressure()
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		HandleMemoryPressure(lock);
+	}
+
+	//
+	//NotifyWaitingThreads
+	//
+	void MemoryPool::NotifyWaitingThreads()
+	{
+		if (m_uiWaitingThreads)
+		{
+			m_cvMemoryFreed.notify_all();
+		}
+	}
+
+	//
+	//Trim
+	//
+	std::size_t MemoryPool::Trim()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		std::size_t sBytesReleased = 0;
+		unsigned int uiSegmentsReleased = 0;
+		ReleaseUnusedSegments(sBytesReleased, uiSegmentsReleased);
+		if (sBytesReleased)
+		{
+			NotifyWaitingThreads();
+		}
+		return sBytesReleased;
+	}
+
+	//
+	//GetMemoryPoolSize
+	//
+	std::size_t MemoryPool::GetMemoryPoolSize()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_sTotalMemoryPoolSize;
+	}
+
+	//
+	//GetUsedMemoryPoolSize
+	//
+	std::size_t MemoryPool::GetUsedMemoryPoolSize()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_sUsedMemoryPoolSize;
+	}
+
+
+	//
+	//CreateChildPool
+	//
+	MemoryPool *MemoryPool::CreateChildPool(const std::size_t &sInitialMemoryPoolSize)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_uiChildPoolCount++;	//decremented by "ReturnSegments()", when the child is deleted
+		}
+
+		MemoryPool *ptrChildPool = new MemoryPool(this, sInitialMemoryPoolSize);
+		ptrChildPool->m_bParentPressurePending = false;	//handled right here
+		HandlePendingMemoryPressure();
+		if (!ptrChildPool->m_ptrFirstSegment)
+		{
+			delete ptrChildPool;	//the initial Segment could not be borrowed
+			return NULL;
+		}
+		return ptrChildPool;
+	}
+
+	//
+	//LendSegment
+	//
+	MemorySegment *MemoryPool::LendSegment(const std::size_t &sMemorySize, const std::size_t &sPreferredSize, MemoryPool *&ptrPoolAtLimit)
+	{
+		//Called by a child pool, which holds its own lock (the lock order is always child -> parent). At the hard limit, the child
+		//releases its lock and calls "LendSegmentAtLimit()", which calls the callbacks.
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return TryLendSegment(sMemorySize, sPreferredSize, ptrPoolAtLimit);
+	}
+
+	//
+	//LendSegmentAtLimit
+	//
+	MemorySegment *MemoryPool::LendSegmentAtLimit(const std::size_t &sMemorySize, const std::size_t &sPreferredSize)
+	{
+		//Same steps as "GrowMemoryPool()" at the hard limit : call the callbacks and trim once, then wait (MEMORY_LIMIT_WAIT) or fail
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		std::chrono::steady_clock::time_point tDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_uiWaitTimeout);
+		bool bPressureHandled = false;
+		while (true)
+		{
+			MemoryPool *ptrPoolAtLimit = NULL;
+			MemorySegment *ptrSegment = TryLendSegment(sMemorySize, sPreferredSize, ptrPoolAtLimit);
+			if ((ptrSegment) || (!ptrPoolAtLimit))
+			{
+				return ptrSegment;	//lent, or the OS is out of memory
+			}
+
+			if (ptrPoolAtLimit != this)
+			{
+				//A parent of this pool is at its hard limit, it is handled there (without holding the lock of this pool)
+				lock.unlock();
+				ptrSegment = m_ptrParentPool->LendSegmentAtLimit(sMemorySize, sPreferredSize);
+				lock.lock();
+				m_bParentPressurePending = true;
+				if (ptrSegment)
+				{
+					IncreaseMemoryPoolSize(ptrSegment->DataSize);	//lent Segments still count for the size of this pool
+				}
+				return ptrSegment;
+			}
+
+			if ((m_sHardLimit != NO_MEMORY_LIMIT) && (sMemorySize > m_sHardLimit))
+			{
+				return NULL;	//can never fit, don't wait for it
+			}
+			else if (!bPressureHandled)
+			{
+				//Give the callbacks a chance to free memory, before failing / waiting
+				bPressureHandled = true;
+				m_ePendingPressure = MEMORY_PRESSURE_HARD_LIMIT;
+				HandleMemoryPressure(lock);
+			}
+			else if ((m_eLimitPolicy == MEMORY_LIMIT_WAIT) && (std::chrono::steady_clock::now() < tDeadline))
+			{
+				m_uiWaitingThreads++;
+				m_cvMemoryFreed.wait_until(lock, tDeadline);
+				m_uiWaitingThreads--;
+			}
+			else
+			{
+				return NULL;
+			}
+		}
+	}
+
+	//
+	//TryLendSegment
+	//
+	MemorySegment *MemoryPool::TryLendSegment(const std::size_t &sMemorySize, const std::size_t &sPreferredSize, MemoryPool *&ptrPoolAtLimit)
+	{
+		MemorySegment *ptrSegment = TakeSpareSegment(sPreferredSize);
+		if (ptrSegment)
+		{
+			return ptrSegment;	//already counted in the size of this pool
+		}
+
+		//New Segments have at least the minimal size, so they can be lent to the next child again
+		std::size_t sAllocationSize = MaxValue(sPreferredSize, CalculateBestMemoryBlockSize(m_sMinimalMemorySizeToAllocate));
+		if (!IsWithinHardLimit(sAllocationSize))
+		{
+			ptrSegment = TakeSpareSegment(sMemorySize);	//a smaller spare Segment still holds the request
+			if (ptrSegment)
+			{
+				return ptrSegment;
+			}
+
+			std::size_t sBytesReleased = 0;
+			unsigned int uiSegmentsReleased = 0;
+			ReleaseSpareSegments(sBytesReleased, uiSegmentsReleased);	//the spare Segments are too small, make room for a new one
+			if (!IsWithinHardLimit(sAllocationSize))
+			{
+				sAllocationSize = sMemorySize;
+			}
+			if (!IsWithinHardLimit(sAllocationSize))
+			{
+				ptrPoolAtLimit = this;
+				return NULL;
+			}
+		}
+
+		if (m_ptrParentPool)
+		{
+			ptrSegment = m_ptrParentPool->LendSegment(sMemorySize, sAllocationSize, ptrPoolAtLimit);
+			m_bParentPressurePending = true;	//passed on, when the child handles the pressure of this pool
+		}
+		else
+		{
+			ptrSegment = CreateSegment(sAllocationSize);
+		}
+		if (ptrSegment)
+		{
+			IncreaseMemoryPoolSize(ptrSegment->DataSize);	//lent Segments still count for the size of this pool
+		}
+		return ptrSegment;
+	}
+
+	//
+	//ReturnSegments
+	//
+	void MemoryPool::ReturnSegments(MemorySegment *ptrFirstSegment, MemorySegment *ptrLastSegment, bool bDetachChildPool)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (ptrFirstSegment)
+		{
+			ptrLastSegment->Next = m_ptrSpareSegments;	//O(1), neither the Segments nor their Chunks are visited
+			m_ptrSpareSegments = ptrFirstSegment;
+			NotifyWaitingThreads();	//a request waiting at the hard limit can use a spare Segment
+		}
+		if (bDetachChildPool)
+		{
+			assert((m_uiChildPoolCount > 0) && "ERROR : Request to delete more child pools then created.");
+			m_uiChildPoolCount--;
+		}
+	}
+
+	//
+	//TakeSpareSegment
+	//
+	MemorySegment *MemoryPool::TakeSpareSegment(const std::size_t &sMemorySize)
+	{
+		MemorySegment *ptrPreviousSegment = NULL;
+		for (MemorySegment *ptrSegment = m_ptrSpareSegments; ptrSegment; ptrSegment = ptrSegment->Next)
+		{
+			if (ptrSegment->DataSize >= sMemorySize)
+			{
+				if (ptrPreviousSegment)
+				{
+					ptrPreviousSegment->Next = ptrSegment->Next;
+				}
+				else
+				{
+					m_ptrSpareSegments = ptrSegment->Next;
+				}
+				ptrSegment->Next = NULL;
+				return ptrSegment;
+			}
+			ptrPreviousSegment = ptrSegment;
+		}
+		return NULL;
+	}
+
+	//
+	//ReuseSpareSegment
+	//
+	bool MemoryPool::ReuseSpareSegment(const std::size_t &sMemorySize)
+	{
+		MemorySegment *ptrSegment = TakeSpareSegment(sMemorySize);
+		if (!ptrSegment)
+		{
+			return false;
+		}
+
+		m_sFreeMemoryPoolSize += ptrSegment->DataSize;	//"m_sTotalMemoryPoolSize" already counts the spare Segment
+		m_sMemoryChunkCount += ptrSegment->ChunkCount;
+		m_uiSegmentCount++;
+		return LinkChunksToData(ptrSegment);	//resets the high-water mark, the Chunks of the previous owner are not visited
+	}
+
+	//
+	//ReleaseSpareSegments
+	//
+	void MemoryPool::ReleaseSpareSegments(std::size_t &sBytesReleased, unsigned int &uiSegmentsReleased)
+	{
+		if (!m_ptrSpareSegments)
+		{
+			return;
+		}
+
+		MemorySegment *ptrLastSegment = m_ptrSpareSegments;
+		while (true)
+		{
+			m_sTotalMemoryPoolSize -= ptrLastSegment->DataSize;
+			sBytesReleased += ptrLastSegment->DataSize;
+			uiSegmentsReleased++;
+			if (!ptrLastSegment->Next)
+			{
+				break;
+			}
+			ptrLastSegment = ptrLastSegment->Next;
+		}
+		FreeSegments(m_ptrSpareSegments, ptrLastSegment);
+		m_ptrSpareSegments = NULL;
+	}
+
+	//
+	//FreeSegments
+	//
+	void MemoryPool::FreeSegments(MemorySegment *ptrFirstSegment, MemorySegment *ptrLastSegment)
+	{
+		if (m_ptrParentPool)
+		{
+			m_ptrParentPool->ReturnSegments(ptrFirstSegment, ptrLastSegment, false);	//the Segments are borrowed
+			return;
+		}
+
+		MemorySegment *ptrSegment = ptrFirstSegment;
+		while (ptrSegment)
+		{
+			MemorySegment *ptrNextSegment = ptrSegment->Next;
+			free(((void*)ptrSegment->Data));
+			free(((void*)ptrSegment));
+			ptrSegment = ptrNextSegment;
+		}
+	}
+
 }
\ No newline at end of file
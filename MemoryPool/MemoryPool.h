@@ -7,6 +7,15 @@
 
 #include "MemoryBlock.h"
 #include "MemoryChunk.h"
+#include "MemorySegment.h"
+#include "MemoryHandle.h"
+#include "HeapProfiler.h"
+#include "MemoryLimit.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
 
 namespace MemoryPool
 {
@@ -16,6 +25,7 @@ namespace MemoryPool
 
 	//class MemoryPool
 	//This class responsible for all MemoryRequests (GetMemory() / FreeMemory()) and manages the allocation of Memory from Operating-System
+	//All public methods are thread-safe.
 
 	class MemoryPool : public MemoryBlock
 	{
@@ -39,7 +49,8 @@ namespace MemoryPool
 
 		//GetMemory :				Get "sMemorySize" Bytes from the Memory Pool.
 		//<param> sMemorySize :		Sizes (in Bytes) of Memory.
-		//<Return> :				Pointer to a Memory-Block of "sMemorySize" Bytes, or NULL if an error occured. 
+		//<Return> :				Pointer to a Memory-Block of "sMemorySize" Bytes, or NULL if an error occured (the OS is out of memory, or the
+		//							request does not fit below the hard limit, see "SetMemoryLimits()").
 		virtual void *GetMemory(const std::size_t &sMemorySize);
 		
 		//FreeMemory :				Free the allocated memory again!
@@ -57,43 +68,175 @@ namespace MemoryPool
 		//<Return> :				true, if the Pointer could be found in the Memory-Pool, false otherwise.
 		bool IsValidPointer(void* ptrPointer);
 
+		//GetHandle :				Get "sMemorySize" Bytes of relocatable Memory from the Memory Pool. The Memory may be moved by "Compact()" while it is not pinned.
+		//<param> sMemorySize :		Sizes (in Bytes) of Memory.
+		//<Return> :				Handle to the Memory-Block, or INVALID_MEMORY_HANDLE if an error occured (see "GetMemory()").
+		MemoryHandle GetHandle(const std::size_t &sMemorySize);
+
+		//FreeHandle :				Free the Memory of the given Handle again. The Handle must not be pinned.
+		//<param> hMemory :			Handle previously returned by "GetHandle()".
+		void FreeHandle(MemoryHandle hMemory);
+
+		//PinHandle :				Pin the Memory of the given Handle, so it won't be moved by "Compact()" until "UnpinHandle()" is called. Pins can be nested.
+		//<param> hMemory :			Handle previously returned by "GetHandle()".
+		//<Return> :				Pointer to the Memory-Block, which is valid until the Handle is unpinned.
+		void *PinHandle(MemoryHandle hMemory);
+
+		//UnpinHandle :				Release a Pin taken by "PinHandle()".
+		//<param> hMemory :			Handle previously pinned via "PinHandle()".
+		void UnpinHandle(MemoryHandle hMemory);
+
+		//Compact :					Move unpinned Handle-Memory together, so the free Memory becomes contiguous. Segments which become completely free are given back to the OS
+		//							(except the first one). Memory returned by "GetMemory()" and pinned Handles are never moved.
+		//<param> sBudget :			The maximum amount of Memory (in Bytes) which may be copied.
+		//<Return> :				Bytes moved / released and the fragmentation of the free Memory before and after compacting.
+		CompactionStats Compact(const std::size_t &sBudget);
+
+		//EnableHeapProfiler :		Start sampling allocations (see HeapProfiler.h). Allocations made before are not sampled.
+		//<param> sSampleInterval :	Average distance (in Bytes) between two sampled allocations.
+		//<param> strLeakReportFileName : File for the leak report written by the destructor, if objects are still allocated. Empty = std::cerr.
+		void EnableHeapProfiler(const std::size_t &sSampleInterval = DEFAULT_HEAP_PROFILER_SAMPLE_INTERVAL, const std::string &strLeakReportFileName = "");
+
+		//DumpHeapProfile :			Write the live sampled allocations, grouped by call-stack, to a File in pprof's heap profile format.
+		//<param> strFileName :		FileName of the heap profile.
+		//<Return> :				true on success, false otherwise (e.g. the HeapProfiler is not enabled)
+		bool DumpHeapProfile(const std::string &strFileName);
+
+		//SetMemoryLimits :			Limit the size of the MemoryPool (the Memory requested from the OS). Memory already allocated is not affected.
+		//<param> sSoftLimit :		When the pool grows beyond this size, the pressure callbacks are called and unused Segments are given back to the OS. NO_MEMORY_LIMIT = no soft limit.
+		//<param> sHardLimit :		The pool never grows beyond this size. NO_MEMORY_LIMIT = no hard limit.
+		//<param> ePolicy :			What a request does, which does not fit below the hard limit (return NULL or wait).
+		//<param> uiWaitTimeout :	Maximum time (in Milliseconds) a request waits for memory to be freed (only used by MEMORY_LIMIT_WAIT).
+		void SetMemoryLimits(const std::size_t &sSoftLimit, const std::size_t &sHardLimit, MemoryLimitPolicy ePolicy = MEMORY_LIMIT_FAIL_FAST, unsigned int uiWaitTimeout = 0);
+
+		//AddMemoryPressureCallback :	Register a callback, which is called when the soft limit is crossed or a request hits the hard limit.
+		//<param> fnCallback :			Function to call (see MemoryLimit.h).
+		//<param> ptrUserData :			Passed to the callback unchanged.
+		void AddMemoryPressureCallback(MemoryPressureCallback fnCallback, void *ptrUserData);
+
+		//RemoveMemoryPressureCallback : Unregister a callback previously registered with the same "fnCallback" / "ptrUserData".
+		void RemoveMemoryPressureCallback(MemoryPressureCallback fnCallback, void *ptrUserData);
+
+		//Trim :					Give the Segments which are completely unused back to the OS (except the first one). Memory is never moved.
+		//<Return> :				The amount of Memory (in Bytes) given back to the OS.
+		std::size_t Trim();
+
+		//GetMemoryPoolSize :		return the size of the MemoryPool (the Memory requested from the OS) in Bytes.
+		std::size_t GetMemoryPoolSize();
+
+		//GetUsedMemoryPoolSize :	return the amount of used Memory in Bytes.
+		std::size_t GetUsedMemoryPoolSize();
+
+		//CreateChildPool :			Create a MemoryPool, which borrows whole Segments from this pool and serves its own allocations from them. Deleting
+		//							the child gives all its Segments back to this pool in one step, the objects still allocated in the child are released
+		//							with them (no "FreeMemory()" needed). A child has its own lock, so it can be used by a single thread without contention.
+		//							The Segments borrowed by children count for the size (and the limits) of this pool. Delete all children before this pool.
+		//							The pressure callbacks of this pool may be called by a thread using a child, but never while it holds the lock of the child.
+		//<param> sInitialMemoryPoolSize : The Initial Size (in Bytes) of the child pool.
+		//<Return> :				The child pool (free it via "delete"), or NULL if the initial Memory could not be borrowed.
+		MemoryPool *CreateChildPool(const std::size_t &sInitialMemoryPoolSize = DEFAULT_MEMORY_POOL_SIZE);
+
 	private:
+		MemoryPool(MemoryPool *ptrParentPool, const std::size_t &sInitialMemoryPoolSize);	//Constructor of a child pool, see "CreateChildPool()"
+		void InitializeMembers(const std::size_t &sMemoryChunkSize, const std::size_t &sMinimalMemorySizeToAllocate, bool bSetMemoryData);	//Set all members to their initial values (used by the constructors)
+
 		//Allocatememory :			Will Allocate "sMemorySize" Bytes of Memory from the OS. The Memory will be cut into Pieces and Managed by the MemoryChunk-Linked-List.(See LinkChunksToData() for details)
 		//<param> sMemorySize :		The Memory-Size (in Bytes) to allocate
 		//<Return> :				true, if the Memory could be allocated, false otherwise (e.g. System is out of Memory, etc.)
 		bool AllocateMemory(const std::size_t &sMemorySize);
+		MemorySegment *CreateSegment(const std::size_t &sMemorySize);	//Allocate a Segment managing "sMemorySize" Bytes (and its Chunks) from the OS, NULL on failure.
+		void IncreaseMemoryPoolSize(const std::size_t &sMemorySize);	//Add "sMemorySize" Bytes to the size of the pool, and note when the soft limit is crossed.
+		MemoryChunk *GetChunks(std::unique_lock<std::mutex> &lock, const std::size_t &sMemorySize);	//return the first of the Chunks holding "sMemorySize" Bytes, grows the MemoryPool if needed (NULL on failure). (Used by "GetMemory()" / "GetHandle()")
+		MemoryChunk *GrowMemoryPool(std::unique_lock<std::mutex> &lock, const std::size_t &sMemorySize);	//Allocate Memory from the OS (within the hard limit) until a Chunk can hold "sMemorySize" Bytes. return the Chunk or NULL.
+		bool IsWithinHardLimit(const std::size_t &sMemorySize) const;	//true, if the pool can grow by "sMemorySize" Bytes without crossing the hard limit.
+		void HandleMemoryPressure(std::unique_lock<std::mutex> &lock);	//Call the pressure callbacks (with "lock" released) and trim the pool, if a limit was hit (here or in the parent). Does nothing otherwise.
+		void HandlePendingMemoryPressure();	//Take the lock and handle a limit hit while lending Segments to a child pool (called by the child, without holding its lock).
+		void ReleaseUnusedSegments(std::size_t &sBytesReleased, unsigned int &uiSegmentsReleased);	//Give all unused Segments except the first one back to the OS.
+		void NotifyWaitingThreads();	//Wake up the requests waiting at the hard limit (see MEMORY_LIMIT_WAIT), after memory was freed.
+
+		bool BorrowMemory(std::unique_lock<std::mutex> &lock, const std::size_t &sMemorySize, const std::size_t &sPreferredSize);	//Borrow a Segment from the parent pool (see "AllocateMemory()"), at the parent's hard limit with "lock" released.
+		bool AddSegment(MemorySegment *ptrNewSegment);	//Count a new Segment in the size of the pool and append it to the Linked-List of MemorySegments.
+		MemorySegment *LendSegment(const std::size_t &sMemorySize, const std::size_t &sPreferredSize, MemoryPool *&ptrPoolAtLimit);	//Hand an unused Segment of "sPreferredSize" (at least "sMemorySize") Bytes to a child pool, NULL on failure ("ptrPoolAtLimit" : the pool at its hard limit, if any).
+		MemorySegment *LendSegmentAtLimit(const std::size_t &sMemorySize, const std::size_t &sPreferredSize);	//"LendSegment()" for a child at the hard limit : calls the callbacks, trims, waits (see MEMORY_LIMIT_WAIT). The child must not hold its lock.
+		MemorySegment *TryLendSegment(const std::size_t &sMemorySize, const std::size_t &sPreferredSize, MemoryPool *&ptrPoolAtLimit);	//"LendSegment()" with the lock held.
+		void ReturnSegments(MemorySegment *ptrFirstSegment, MemorySegment *ptrLastSegment, bool bDetachChildPool);	//Take the linked Segments back from a child pool as spare Segments, in O(1).
+		MemorySegment *TakeSpareSegment(const std::size_t &sMemorySize);	//Unlink and return a spare Segment of at least "sMemorySize" Bytes, or NULL.
+		bool ReuseSpareSegment(const std::size_t &sMemorySize);	//Move a spare Segment of at least "sMemorySize" Bytes into the Linked-List of Segments. true on success.
+		void ReleaseSpareSegments(std::size_t &sBytesReleased, unsigned int &uiSegmentsReleased);	//Give all spare Segments back (see "FreeSegments()").
+		void FreeSegments(MemorySegment *ptrFirstSegment, MemorySegment *ptrLastSegment);	//Give the linked Segments back to the parent pool, or to the OS if this is not a child pool.
 		void FreeAllAllocatedMemory();		//Free all allocated memory to the OS.
 		
-		unsigned int CalculateNeededChunks(const std::size_t &sMemorySize);	//return the Number of MemoryChunks needed to Manage "sMemorySize" Bytes.
+		std::size_t CalculateNeededChunks(const std::size_t &sMemorySize);	//return the Number of MemoryChunks needed to Manage "sMemorySize" Bytes (exact integer ceiling, see "m_uiMemoryChunkShift").
+		bool CalculateChunkIndex(const std::size_t &sOffset, std::size_t &sChunkIndex);	//Set "sChunkIndex" to the Chunk managing the byte at "sOffset" of a Segment. return true, if "sOffset" is the beginning of that Chunk.
 		std::size_t CalculateBestMemoryBlockSize(const std::size_t &sRequestedMemoryBlockSize);	//return the amount of Memory which is best Managed by the MemoryChunks.
 
 		MemoryChunk *FindChunkSuitableToHoldMemory(const std::size_t &sMemorySize);	//return a Chunk which can hold the requested amount of memory, or NULL, if none was found.
+		MemoryChunk *FindFreeChunksInSegment(MemorySegment *ptrSegment, std::size_t sStartChunk, const std::size_t &sMemorySize);	//return the first of enough free, contiguous Chunks inside "ptrSegment" (searching from "sStartChunk"), or NULL.
 		MemoryChunk *FindChunkHoldingPointerTo(void *ptrMemoryBlock);	//Find a Chunk which "Data"-Member is Pointing to the given "ptrMemoryBlock", or NULL if none was found.
-		MemoryChunk *SkipChunks(MemoryChunk *ptrStartChunk, unsigned int uiChunksToSkip);	//Skip the given amount of Chunks, starting from the given ptrStartChunk. \return the Chunk at the "skipping" - Position.
+		MemorySegment *FindSegmentHoldingPointerTo(void *ptrMemoryBlock);	//Find the Segment which memory block contains the given "ptrMemoryBlock", or NULL if none was found.
 		MemoryChunk *SetChunkDefaults(MemoryChunk *ptrChunk);	//Set "Default"-Values to the given Chunk
 		
 		void FreeChunks(MemoryChunk *ptrChunk);	//Makes the memory linked to the given Chunk available in the MemoryPool again (by setting the "UsedSize"-Member to 0).
 		void DeallocateAllChunks();	//Deallocates all Memory needed by the Chunks back to the OS.
-		bool LinkChunksToData(MemoryChunk *ptrNewChunk, unsigned int uiChunkCount, TByte *ptrNewMemBlock);	//Link the given Memory-Block to the Linked-List of MemoryChunks...
+		bool LinkChunksToData(MemorySegment *ptrNewSegment);	//Append the given Segment to the Linked-List of MemorySegments. Its Chunks are linked to the Memory-Block later (see "InitializeChunks()")
 		void SetMemoryChunkValues(MemoryChunk *ptrChunk, const std::size_t &sMemBlockSize);	//Set the "UsedSize"-Member of the given "ptrChunk" to "sMemBlockSize".
-		bool RecalcChunkMemorySize(MemoryChunk *ptrChunks, unsigned int uiChunkCount);	//Recalcs the "DataSize" - Member of all Chunks whe the Memory - Pool grows(via "AllocateMemory()")
+		void InitializeChunks(MemorySegment *ptrSegment, std::size_t sChunkCount);	//Initialize the Chunks of the given Segment up to "sChunkCount" (raises the high-water mark), when they are handed out for the first time.
 		
 		std::size_t MaxValue(const std::size_t &sValueA, const std::size_t &sValueB) const;	//return the greatest of the two input values (A or B)
 
-		MemoryChunk *m_ptrFirstChunk;		//Pointer to the first Chunk in the Linked-List of Memory Chunks
-		MemoryChunk *m_ptrLastChunk;		//Pointer to the last Chunk in the Linked-List of Memory Chunks
+		MemoryHandle AcquireHandleEntry();	//return an unused entry of the handle table (grows the table if needed), or INVALID_MEMORY_HANDLE if the table can't grow.
+		bool IsMovable(MemoryChunk *ptrChunk) const;	//true, if the memory of the given (used) Chunk belongs to an unpinned Handle and may be moved by "Compact()".
+		void MoveChunks(MemoryChunk *ptrSourceChunk, MemoryChunk *ptrDestinationChunk);	//Move the memory of "ptrSourceChunk" to the free Chunks starting at "ptrDestinationChunk" and update the handle table.
+		bool EvacuateSegment(MemorySegment *ptrSegment, MemorySegment *ptrSegmentEnd, const std::size_t &sBudget, std::size_t &sBytesMoved);	//Move all memory of "ptrSegment" into the Segments before "ptrSegmentEnd". true, if the Segment is empty afterwards.
+		void SlideSegment(MemorySegment *ptrSegment, const std::size_t &sBudget, std::size_t &sBytesMoved);	//Move the movable memory of "ptrSegment" to the front of the Segment.
+		bool IsSegmentUnused(MemorySegment *ptrSegment) const;	//true, if no Chunk of the given Segment is in use.
+		void ReleaseSegment(MemorySegment *ptrSegment, MemorySegment *ptrPreviousSegment);	//Unlink the given (unused) Segment and give its memory back to the OS.
+		double CalculateFragmentation();	//return 1 - (largest free block / total free memory), 0.0 if there is no free memory.
+		bool WriteHeapProfile(const std::string &strFileName);	//Write the heap profile to a File, without taking the lock (see "DumpHeapProfile()").
+		void WriteLeakReport();	//Write the heap profile of the leaked allocations (see "EnableHeapProfiler()"), called by the destructor.
+
+		MemorySegment *m_ptrFirstSegment;	//Pointer to the first Segment in the Linked-List of Memory Segments
+		MemorySegment *m_ptrLastSegment;	//Pointer to the last Segment in the Linked-List of Memory Segments
+		MemorySegment *m_ptrCursorSegment;	//Segment holding the Cursor-Chunk.
 		MemoryChunk *m_ptrCursorChunk;		//Cursor-Chunk. Used to speed up the navigation in the linked-List.
+		unsigned int m_uiSegmentCount;		//Total amount of "MemorySegment"-Objects in the Memory-Pool.
+
+		MemoryHandleEntry *m_ptrHandles;	//The handle table, entry 0 is never used (INVALID_MEMORY_HANDLE)
+		unsigned int m_uiHandleCapacity;	//number of entries allocated for the handle table
+		unsigned int m_uiHandleCount;		//number of entries of the handle table which have been used so far
+		unsigned int m_uiFreeHandle;		//first entry of the free list of the handle table, 0 if the list is empty
 
 		std::size_t m_sTotalMemoryPoolSize;	//Total Memory-Pool size in Bytes
 		std::size_t m_sUsedMemoryPoolSize;  //amount of used Memory in Bytes
 		std::size_t m_sFreeMemoryPoolSize;  //amount of free Memory in Bytes
 
 		std::size_t m_sMemoryChunkSize;     //amount of Memory which can be Managed by a single MemoryChunk.
-		unsigned int m_uiMemoryChunkCount;  //Total amount of "MemoryChunk"-Objects in the Memory-Pool.
+		std::size_t m_sMemoryChunkMask;     //"m_sMemoryChunkSize - 1", if "m_sMemoryChunkSize" is a power of two (only used together with "m_uiMemoryChunkShift").
+		unsigned int m_uiMemoryChunkShift;  //log2("m_sMemoryChunkSize"), if it is a power of two, 0 otherwise. Chunk math uses shift/mask instead of division then.
+		std::size_t m_sMemoryChunkCount;    //Total amount of "MemoryChunk"-Objects in the Memory-Pool.
 		unsigned int m_uiObjectCount;       //Counter for "GetMemory()" / "FreeMemory()"-Operation. Counts (indirectly) the number of "Objects" inside the mem-Pool.
 
 		bool m_bSetMemoryData;                      //Set to "true", if you want to set all (de)allocated Memory to a predefined Value (via "memset()"). Usefull for debugging.
 		std::size_t m_sMinimalMemorySizeToAllocate; //The minimal amount of Memory which can be allocated via "AllocateMemory()".
+
+		HeapProfiler *m_ptrHeapProfiler;			//Samples the allocations, NULL if not enabled (see "EnableHeapProfiler()")
+		std::string m_strLeakReportFileName;		//File for the leak report, empty = std::cerr
+
+		std::size_t m_sSoftLimit;					//see "SetMemoryLimits()", NO_MEMORY_LIMIT if not set
+		std::size_t m_sHardLimit;					//see "SetMemoryLimits()", NO_MEMORY_LIMIT if not set
+		MemoryLimitPolicy m_eLimitPolicy;			//What a request does at the hard limit
+		unsigned int m_uiWaitTimeout;				//Timeout (in Milliseconds) for MEMORY_LIMIT_WAIT
+		MemoryPressureLevel m_ePendingPressure;		//Limit which was hit, but the callbacks have not been called yet
+		std::vector<MemoryPressureCallbackEntry> m_PressureCallbacks;	//see "AddMemoryPressureCallback()"
+
+		std::mutex m_Mutex;							//Protects all members, taken by every public method
+		std::condition_variable m_cvMemoryFreed;	//Signaled when memory is freed and a request waits at the hard limit
+		unsigned int m_uiWaitingThreads;			//number of requests waiting on "m_cvMemoryFreed"
+
+		MemoryPool *m_ptrParentPool;				//The pool lending the Segments of this child pool, NULL if this is not a child pool
+		bool m_bParentPressurePending;				//true, if Segments were borrowed from the parent since its pressure was handled last
+		MemorySegment *m_ptrSpareSegments;			//Free Segments returned by child pools, ready to be lent again (not in the Linked-List of Segments)
+		unsigned int m_uiChildPoolCount;			//number of child pools, which have not been deleted yet
 	};
 }
 #endif	//_MEMORYPOOL_H
\ No newline at end of file
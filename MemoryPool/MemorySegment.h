@@ -0,0 +1,28 @@
+//
+//MemorySegment.h
+//
+//Contains the MemorySegment definition
+//Every block of memory requested from the OS (via "AllocateMemory()") is a MemorySegment. The segment owns the 
+//memory block and the array of MemoryChunks managing it, and points to the next segment creating a linked list of segments
+//
+
+#ifndef _MEMORYSEGMENT_H
+#define _MEMORYSEGMENT_H
+
+#include "MemoryChunk.h"
+
+namespace MemoryPool
+{
+
+	typedef struct MemorySegment
+	{
+		TByte *Data;				//The memory block allocated from the OS
+		std::size_t DataSize;		//size of the "data" block
+		MemoryChunk *Chunks;		//array of MemoryChunks managing the "data" block, Chunks[i].Data == &Data[i * ChunkSize]
+		std::size_t ChunkCount;			//number of MemoryChunks in the "Chunks" array
+		std::size_t InitializedChunks;	//high-water mark: only Chunks[0 .. InitializedChunks) are initialized, all Chunks after it are free
+		MemorySegment *Next;		//pointer to the next MemorySegment in the list, may be NULL
+	}MemorySegment;
+}
+
+#endif //_MEMORYSEGMENT_H
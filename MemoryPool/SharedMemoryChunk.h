@@ -0,0 +1,54 @@
+//
+//SharedMemoryChunk.h
+//
+//Contains the SharedMemoryChunk and SharedMemoryHeader definitions
+//They are the MemoryChunk counterparts for a SharedMemoryPool. The memory region is mapped at a different address
+//in every process, so everything inside of it is stored as an offset from the beginning of the region instead of a pointer.
+//
+
+#ifndef _SHAREDMEMORYCHUNK_H
+#define _SHAREDMEMORYCHUNK_H
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#include "MemoryBlock.h"
+
+namespace MemoryPool
+{
+	typedef std::size_t TOffset;		//Offset (in Bytes) from the beginning of a shared memory region, 0 is never a valid offset (the header lives there)
+
+	typedef struct SharedMemoryChunk
+	{
+		TOffset Data;			//Offset of the actual data
+		std::size_t DataSize;	//size of the "data" block, until the end of the region
+		std::size_t UsedSize;	//actual used size
+		TOffset Next;			//Offset of the next SharedMemoryChunk in the region, 0 at the end of the list
+	}SharedMemoryChunk;
+
+	typedef struct SharedMemoryHeader
+	{
+		unsigned int Magic;						//SHARED_MEMORY_POOL_MAGIC, when the region has been set up completely
+		unsigned int Version;					//Layout version of the region
+#ifndef _WIN32
+		pthread_mutex_t Mutex;					//Robust, process-shared lock of the header and the chunks (Windows uses a named mutex instead)
+#endif
+		unsigned int Clean;						//1, if the chunks and the header have not changed since the last completed "Checkpoint()" (file-backed pools)
+		unsigned int DirtySynced;				//1, if "Clean" is 0 in the file (not only in memory), so the chunks and the header may be changed
+		std::size_t RegionSize;					//Total size (in Bytes) of the region, including header and chunks
+		std::size_t MemoryChunkSize;			//amount of Memory which can be Managed by a single SharedMemoryChunk.
+		std::size_t MemoryChunkCount;			//Total amount of "SharedMemoryChunk"-Objects in the region.
+		std::size_t InitializedChunks;			//high-water mark: only the Chunks before it are initialized, all Chunks after it are free
+		TOffset Chunks;							//Offset of the SharedMemoryChunk array
+		TOffset Data;							//Offset of the memory managed by the chunks
+		TOffset CursorChunk;					//Offset of the Cursor-Chunk. Used to speed up the search for free chunks.
+		std::size_t UsedMemoryPoolSize;			//amount of used Memory in Bytes
+		std::size_t ObjectCount;				//Counter for "GetMemory()" / "FreeMemory()"-Operation of all processes.
+		TOffset Root;							//Offset of the application's root object (see "SetRootOffset()"), 0 if none was set
+		std::size_t CheckpointCount;			//Number of completed "Checkpoint()"-calls (file-backed pools)
+		std::size_t Generation;					//Number of changes of the chunks and the header, "Checkpoint()" uses it to detect changes during a flush
+	}SharedMemoryHeader;
+}
+
+#endif //_SHAREDMEMORYCHUNK_H
@@ -0,0 +1,818 @@
+//
+//SharedMemoryPool.cc
+//
+
+#include "HeaderFiles.h"
+#include "SharedMemoryPool.h"
+
+#include <atomic>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace MemoryPool
+{
+	static const unsigned int SHARED_MEMORY_POOL_MAGIC = 0x4C4F504D;	//"MPOL", set when the region is set up completely
+	static const unsigned int SHARED_MEMORY_POOL_VERSION = 5;			//Layout version of the region
+	static const int SHARED_MEMORY_CHECKPOINT_ATTEMPTS = 3;				//"Checkpoint()" gives up, when the pool changed during this many flushes
+	static const std::size_t SHARED_MEMORY_ALIGNMENT = 64;				//Alignment of the chunk array and the data (one cache line)
+
+	//
+	//AlignOffset
+	//
+	static TOffset AlignOffset(const TOffset &sOffset)
+	{
+		return ((sOffset + (SHARED_MEMORY_ALIGNMENT - 1)) & ~(SHARED_MEMORY_ALIGNMENT - 1));
+	}
+
+	//
+	//CalculateDataOffset
+	//
+	static TOffset CalculateDataOffset(const std::size_t &sChunkCount)
+	{
+		//Layout of a region : Header | SharedMemoryChunk array | Data
+		return AlignOffset(AlignOffset(sizeof(SharedMemoryHeader)) + (sChunkCount * sizeof(SharedMemoryChunk)));
+	}
+
+	//
+	//Constructor
+	//
+	SharedMemoryPool::SharedMemoryPool()
+	{
+		m_ptrRegion = NULL;
+		m_ptrHeader = NULL;
+		m_sMappedSize = 0;
+		m_bFile = false;
+#ifdef _WIN32
+		m_hMapping = NULL;
+		m_hFile = NULL;
+		m_hMutex = NULL;
+#endif
+	}
+
+	//
+	//Destructor
+	//
+	SharedMemoryPool::~SharedMemoryPool()
+	{
+		Close();
+	}
+
+	//
+	//Create
+	//
+	bool SharedMemoryPool::Create(const std::string &strName, const std::size_t &sMemoryPoolSize, const std::size_t &sMemoryChunkSize)
+	{
+		return CreateRegion(strName, sMemoryPoolSize, sMemoryChunkSize, false);
+	}
+
+	//
+	//Open
+	//
+	bool SharedMemoryPool::Open(const std::string &strName)
+	{
+		return OpenRegion(strName, false);
+	}
+
+	//
+	//CreateMappedFile
+	//
+	bool SharedMemoryPool::CreateMappedFile(const std::string &strFileName, const std::size_t &sMemoryPoolSize, const std::size_t &sMemoryChunkSize)
+	{
+		return CreateRegion(strFileName, sMemoryPoolSize, sMemoryChunkSize, true);
+	}
+
+	//
+	//OpenMappedFile
+	//
+	bool SharedMemoryPool::OpenMappedFile(const std::string &strFileName)
+	{
+		if (!OpenRegion(strFileName, true))
+		{
+			return false;
+		}
+
+		if (!m_ptrHeader->Clean)
+		{
+			//The pool was changed after its last Checkpoint() (e.g. the writing process crashed in between). The kernel writes
+			//the pages of the mapping back at any time, so the chunks and the header in the file may be inconsistent.
+			Unmap();
+			return false;
+		}
+
+		//No change was in progress, but the Lock in the file may still be held by a process which is gone (e.g. after a reboot,
+		//a robust mutex only notices the death of its owner while the machine keeps running)
+		if (!InitializeLock())
+		{
+			Unmap();
+			return false;
+		}
+		return true;
+	}
+
+	//
+	//CreateRegion
+	//
+	bool SharedMemoryPool::CreateRegion(const std::string &strName, const std::size_t &sMemoryPoolSize, const std::size_t &sMemoryChunkSize, bool bFile)
+	{
+		assert((sMemoryChunkSize > 0) && "ERROR : The MemoryChunk size must not be 0");
+		Close();
+
+		std::size_t sChunkCount = (sMemoryPoolSize / sMemoryChunkSize) + ((sMemoryPoolSize % sMemoryChunkSize) ? 1 : 0);
+		const std::size_t sMaxSize = (std::size_t)-1;
+		if ((sChunkCount == 0) || (sMemoryChunkSize > (sMaxSize / 2)) || (sChunkCount > ((sMaxSize / 2) / (sizeof(SharedMemoryChunk) + sMemoryChunkSize))))
+		{
+			return false;	//empty, or the region size would wrap around (the header and the alignment need less than half of it)
+		}
+
+		std::size_t sRegionSize = CalculateDataOffset(sChunkCount) + (sChunkCount * sMemoryChunkSize);
+		if (!MapRegion(strName, sRegionSize, true, bFile))
+		{
+			return false;
+		}
+
+		if (!InitializeLock())
+		{
+			Unmap();
+			if (bFile)
+			{
+				remove(strName.c_str());
+			}
+			else
+			{
+				Remove(strName);
+			}
+			return false;
+		}
+		InitializeRegion(sMemoryChunkSize, sChunkCount);
+		return true;
+	}
+
+	//
+	//OpenRegion
+	//
+	bool SharedMemoryPool::OpenRegion(const std::string &strName, bool bFile)
+	{
+		Close();
+		if (!MapRegion(strName, 0, false, bFile))
+		{
+			return false;
+		}
+
+		if ((m_ptrHeader->Magic != SHARED_MEMORY_POOL_MAGIC) || (m_ptrHeader->Version != SHARED_MEMORY_POOL_VERSION) || (m_ptrHeader->RegionSize > m_sMappedSize))
+		{
+			Unmap();	//not a SharedMemoryPool (or not set up completely)
+			return false;
+		}
+		return true;
+	}
+
+	//
+	//Close
+	//
+	void SharedMemoryPool::Close()
+	{
+		if (m_ptrHeader && m_bFile)
+		{
+			Checkpoint();	//leave a clean file behind, so it can be opened again
+		}
+		Unmap();
+	}
+
+	//
+	//Unmap
+	//
+	void SharedMemoryPool::Unmap()
+	{
+		if (m_ptrRegion)
+		{
+#ifdef _WIN32
+			UnmapViewOfFile(((void*)m_ptrRegion));
+			CloseHandle((HANDLE)m_hMapping);
+			m_hMapping = NULL;
+			CloseHandle((HANDLE)m_hMutex);
+			m_hMutex = NULL;
+			if (m_hFile)
+			{
+				CloseHandle((HANDLE)m_hFile);
+				m_hFile = NULL;
+			}
+#else
+			munmap(((void*)m_ptrRegion), m_sMappedSize);
+#endif
+		}
+
+		m_ptrRegion = NULL;
+		m_ptrHeader = NULL;
+		m_sMappedSize = 0;
+		m_bFile = false;
+	}
+
+	//
+	//Checkpoint
+	//
+	bool SharedMemoryPool::Checkpoint()
+	{
+		if (!m_ptrHeader)
+		{
+			assert(false && "ERROR : SharedMemoryPool is not mapped");
+			return false;
+		}
+
+		if (!m_bFile)
+		{
+			Lock();
+			m_ptrHeader->CheckpointCount++;	//nothing to write, a shared memory object does not survive a reboot
+			Unlock();
+			return true;
+		}
+
+		//The region is flushed without holding the Lock, so the other processes are not stalled by the disk. The file is only
+		//marked clean, if the chunks and the header did not change meanwhile (see "LockForModification()").
+		for (int i = 0; i < SHARED_MEMORY_CHECKPOINT_ATTEMPTS; i++)
+		{
+			Lock();
+			std::size_t sGeneration = m_ptrHeader->Generation;
+			Unlock();
+
+			if (!SyncRegion(m_sMappedSize))
+			{
+				return false;
+			}
+
+			Lock();
+			bool bUnchanged = (m_ptrHeader->Generation == sGeneration);
+			if (bUnchanged)
+			{
+				m_ptrHeader->Clean = 1;
+				m_ptrHeader->DirtySynced = 0;
+				m_ptrHeader->CheckpointCount++;
+			}
+			Unlock();
+
+			if (bUnchanged)
+			{
+				return SyncRegion(sizeof(SharedMemoryHeader));	//the marker reaches the file after the data it vouches for
+			}
+		}
+		return false;	//the pool changed during every flush
+	}
+
+	//
+	//LockForModification
+	//
+	void SharedMemoryPool::LockForModification()
+	{
+		Lock();
+		while (m_bFile && (!m_ptrHeader->DirtySynced))
+		{
+			//The marker has to be cleared in the file, before the kernel may write back any of the changes following it.
+			//The header is flushed without holding the Lock (once per checkpoint interval), so the other processes are not
+			//stalled by the disk. The bump of "Generation" keeps a running "Checkpoint()" from marking the file clean.
+			m_ptrHeader->Clean = 0;
+			m_ptrHeader->Generation++;
+			std::size_t sCheckpointCount = m_ptrHeader->CheckpointCount;
+			Unlock();
+
+			bool bSynced = SyncRegion(sizeof(SharedMemoryHeader));
+			Lock();
+			if (!bSynced)
+			{
+				break;	//the file can't be written, the next change tries again
+			}
+			if (m_ptrHeader->CheckpointCount == sCheckpointCount)
+			{
+				m_ptrHeader->DirtySynced = 1;	//no checkpoint set "Clean" meanwhile, so the flush has written the cleared marker
+			}
+		}
+		m_ptrHeader->Generation++;
+	}
+
+	//
+	//SyncRegion
+	//
+	bool SharedMemoryPool::SyncRegion(const std::size_t &sSize)
+	{
+#ifdef _WIN32
+		return (FlushViewOfFile(((void*)m_ptrRegion), sSize) != 0) && (FlushFileBuffers((HANDLE)m_hFile) != 0);
+#else
+		return (msync(((void*)m_ptrRegion), sSize, MS_SYNC) == 0);
+#endif
+	}
+
+	//
+	//SetRootOffset
+	//
+	void SharedMemoryPool::SetRootOffset(const TOffset &sOffset)
+	{
+		assert(m_ptrHeader && "ERROR : SharedMemoryPool is not mapped");
+		LockForModification();
+		m_ptrHeader->Root = sOffset;
+		Unlock();
+	}
+
+	//
+	//GetRootOffset
+	//
+	TOffset SharedMemoryPool::GetRootOffset()
+	{
+		assert(m_ptrHeader && "ERROR : SharedMemoryPool is not mapped");
+		Lock();
+		TOffset sOffset = m_ptrHeader->Root;
+		Unlock();
+		return sOffset;
+	}
+
+	//
+	//Remove
+	//
+	bool SharedMemoryPool::Remove(const std::string &strName)
+	{
+#ifdef _WIN32
+		(void)strName;	//A file mapping object is destroyed with its last handle
+		return true;
+#else
+		return (shm_unlink(strName.c_str()) == 0);
+#endif
+	}
+
+	//
+	//GetMemory
+	//
+	void *SharedMemoryPool::GetMemory(const std::size_t &sMemorySize)
+	{
+		if (!m_ptrHeader)
+		{
+			assert(false && "ERROR : SharedMemoryPool is not mapped");
+			return NULL;
+		}
+
+		std::size_t sNeededChunks = CalculateNeededChunks(sMemorySize ? sMemorySize : 1);
+		if (sNeededChunks > (((std::size_t)-1) / m_ptrHeader->MemoryChunkSize))
+		{
+			return NULL;	//the size would wrap around, no region can hold it
+		}
+		std::size_t sBestMemBlockSize = sNeededChunks * m_ptrHeader->MemoryChunkSize;
+		LockForModification();	//the search may initialize chunks, even if it fails
+		SharedMemoryChunk *ptrChunk = FindChunkSuitableToHoldMemory(sBestMemBlockSize);
+		if (ptrChunk)
+		{
+			ptrChunk->UsedSize = sBestMemBlockSize;
+			m_ptrHeader->UsedMemoryPoolSize += sBestMemBlockSize;
+			m_ptrHeader->ObjectCount++;
+		}
+		Unlock();
+
+		if (!ptrChunk)
+		{
+			return NULL;	//The pool can't grow, every process maps the same fixed size region
+		}
+		return ((void*)(m_ptrRegion + ptrChunk->Data));
+	}
+
+	//
+	//FreeMemory
+	//
+	void SharedMemoryPool::FreeMemory(void *ptrMemoryBlock, const std::size_t &sMemoryBlockSize)
+	{
+		(void)sMemoryBlockSize;
+		TOffset sOffset = GetOffset(ptrMemoryBlock);
+		if ((sOffset == 0) || (((sOffset - m_ptrHeader->Data) % m_ptrHeader->MemoryChunkSize) != 0))
+		{
+			assert(false && "ERROR : Requested Pointer not in Memory Pool");
+			return;
+		}
+
+		LockForModification();
+		std::size_t sChunkIndex = ((sOffset - m_ptrHeader->Data) / m_ptrHeader->MemoryChunkSize);
+		SharedMemoryChunk *ptrCurrentChunk = GetChunkAt(sChunkIndex);
+		if ((sChunkIndex >= m_ptrHeader->InitializedChunks) || (ptrCurrentChunk->UsedSize == 0))
+		{
+			Unlock();
+			assert(false && "ERROR : Request to delete more Memory then allocated.");
+			return;
+		}
+
+		//Make the Used Memory of the given Chunk available to the Memory Pool again.
+		std::size_t sChunkCount = CalculateNeededChunks(ptrCurrentChunk->UsedSize);
+		m_ptrHeader->UsedMemoryPoolSize -= ptrCurrentChunk->UsedSize;
+		m_ptrHeader->ObjectCount--;
+		for (std::size_t i = 0; (i < sChunkCount) && (ptrCurrentChunk); i++)
+		{
+			ptrCurrentChunk->UsedSize = 0;
+			ptrCurrentChunk = GetChunk(ptrCurrentChunk->Next);
+		}
+		Unlock();
+	}
+
+	//
+	//GetOffset
+	//
+	TOffset SharedMemoryPool::GetOffset(void *ptrPointer)
+	{
+		TByte *ptrData = (TByte*)ptrPointer;
+		if ((!m_ptrHeader) || (ptrData < (m_ptrRegion + m_ptrHeader->Data)) || (ptrData >= (m_ptrRegion + m_ptrHeader->RegionSize)))
+		{
+			return 0;
+		}
+		return (TOffset)(ptrData - m_ptrRegion);
+	}
+
+	//
+	//GetPointer
+	//
+	void *SharedMemoryPool::GetPointer(const TOffset &sOffset)
+	{
+		if ((!m_ptrHeader) || (sOffset < m_ptrHeader->Data) || (sOffset >= m_ptrHeader->RegionSize))
+		{
+			return NULL;
+		}
+		return ((void*)(m_ptrRegion + sOffset));
+	}
+
+	//
+	//IsValidPointer
+	//
+	bool SharedMemoryPool::IsValidPointer(void *ptrPointer)
+	{
+		TOffset sOffset = GetOffset(ptrPointer);
+		return ((sOffset != 0) && (((sOffset - m_ptrHeader->Data) % m_ptrHeader->MemoryChunkSize) == 0));
+	}
+
+	//
+	//MapRegion
+	//
+	bool SharedMemoryPool::MapRegion(const std::string &strName, const std::size_t &sRegionSize, bool bCreate, bool bFile)
+	{
+		void *ptrRegion = NULL;
+		std::size_t sMappedSize = sRegionSize;
+#ifdef _WIN32
+		HANDLE hFile = INVALID_HANDLE_VALUE;	//a mapping without file is backed by the paging file
+		if (bFile)
+		{
+			hFile = CreateFileA(strName.c_str(), (GENERIC_READ | GENERIC_WRITE), 0, NULL, (bCreate ? CREATE_NEW : OPEN_EXISTING), FILE_ATTRIBUTE_NORMAL, NULL);
+			if (hFile == INVALID_HANDLE_VALUE)
+			{
+				return false;
+			}
+		}
+
+		HANDLE hMapping = NULL;
+		if ((bCreate) || (bFile))
+		{
+			unsigned long long ullSize = (unsigned long long)sRegionSize;	//0 uses the size of an existing file
+			hMapping = CreateFileMappingA(hFile, NULL, PAGE_READWRITE, (DWORD)(ullSize >> 32), (DWORD)(ullSize & 0xFFFFFFFF), (bFile ? NULL : strName.c_str()));
+			if ((hMapping) && (!bFile) && (GetLastError() == ERROR_ALREADY_EXISTS))
+			{
+				CloseHandle(hMapping);
+				return false;
+			}
+		}
+		else
+		{
+			hMapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, strName.c_str());
+		}
+		if (!hMapping)
+		{
+			if (bFile)
+			{
+				CloseHandle(hFile);
+				if (bCreate)
+				{
+					DeleteFileA(strName.c_str());
+				}
+			}
+			return false;
+		}
+
+		ptrRegion = MapViewOfFile(hMapping, FILE_MAP_ALL_ACCESS, 0, 0, sRegionSize);	//0 maps the whole object
+		if (!ptrRegion)
+		{
+			CloseHandle(hMapping);
+			if (bFile)
+			{
+				CloseHandle(hFile);
+				if (bCreate)
+				{
+					DeleteFileA(strName.c_str());
+				}
+			}
+			return false;
+		}
+		if (!bCreate)
+		{
+			MEMORY_BASIC_INFORMATION mbi;
+			VirtualQuery(ptrRegion, &mbi, sizeof(mbi));
+			sMappedSize = mbi.RegionSize;
+		}
+		//The processes sharing a mapping object share the mutex by name. A file is only used by one process (see "OpenMappedFile()").
+		HANDLE hMutex = CreateMutexA(NULL, FALSE, (bFile ? NULL : (strName + ".Lock").c_str()));
+		if (!hMutex)
+		{
+			UnmapViewOfFile(ptrRegion);
+			CloseHandle(hMapping);
+			if (bFile)
+			{
+				CloseHandle(hFile);
+				if (bCreate)
+				{
+					DeleteFileA(strName.c_str());
+				}
+			}
+			return false;
+		}
+		m_hMapping = (void*)hMapping;
+		m_hFile = (bFile ? (void*)hFile : NULL);
+		m_hMutex = (void*)hMutex;
+#else
+		int iFlags = (bCreate ? (O_CREAT | O_EXCL | O_RDWR) : O_RDWR);
+		int iFileDescriptor = (bFile ? open(strName.c_str(), iFlags, 0600) : shm_open(strName.c_str(), iFlags, 0600));
+		if (iFileDescriptor < 0)
+		{
+			return false;
+		}
+
+		if (bCreate)
+		{
+			if (ftruncate(iFileDescriptor, (off_t)sRegionSize) != 0)	//the new object is filled with zeros
+			{
+				close(iFileDescriptor);
+				if (bFile)
+				{
+					unlink(strName.c_str());
+				}
+				else
+				{
+					shm_unlink(strName.c_str());
+				}
+				return false;
+			}
+		}
+		else
+		{
+			struct stat stStatus;
+			if ((fstat(iFileDescriptor, &stStatus) != 0) || (((std::size_t)stStatus.st_size) < sizeof(SharedMemoryHeader)))
+			{
+				close(iFileDescriptor);
+				return false;
+			}
+			sMappedSize = (std::size_t)stStatus.st_size;
+		}
+
+		ptrRegion = mmap(NULL, sMappedSize, (PROT_READ | PROT_WRITE), MAP_SHARED, iFileDescriptor, 0);
+		close(iFileDescriptor);	//the mapping keeps the object alive
+		if (ptrRegion == MAP_FAILED)
+		{
+			if ((bCreate) && (bFile))
+			{
+				unlink(strName.c_str());
+			}
+			else if (bCreate)
+			{
+				shm_unlink(strName.c_str());
+			}
+			return false;
+		}
+#endif
+
+		m_ptrRegion = (TByte*)ptrRegion;
+		m_ptrHeader = (SharedMemoryHeader*)ptrRegion;
+		m_sMappedSize = sMappedSize;
+		m_bFile = bFile;
+		return true;
+	}
+
+	//
+	//InitializeRegion
+	//
+	void SharedMemoryPool::InitializeRegion(const std::size_t &sMemoryChunkSize, const std::size_t &sChunkCount)
+	{
+		//The chunks are initialized when they are handed out for the first time (see "InitializeChunks()")
+		m_ptrHeader->Version = SHARED_MEMORY_POOL_VERSION;
+		m_ptrHeader->RegionSize = CalculateDataOffset(sChunkCount) + (sChunkCount * sMemoryChunkSize);
+		m_ptrHeader->MemoryChunkSize = sMemoryChunkSize;
+		m_ptrHeader->MemoryChunkCount = sChunkCount;
+		m_ptrHeader->InitializedChunks = 0;
+		m_ptrHeader->Chunks = AlignOffset(sizeof(SharedMemoryHeader));
+		m_ptrHeader->Data = CalculateDataOffset(sChunkCount);
+		m_ptrHeader->CursorChunk = m_ptrHeader->Chunks;
+		m_ptrHeader->UsedMemoryPoolSize = 0;
+		m_ptrHeader->ObjectCount = 0;
+		m_ptrHeader->Root = 0;
+		m_ptrHeader->CheckpointCount = 0;
+		m_ptrHeader->Clean = 0;	//a new file is clean after the first "Checkpoint()"
+		m_ptrHeader->DirtySynced = 1;	//the file never was clean
+		m_ptrHeader->Generation = 0;
+
+		std::atomic_thread_fence(std::memory_order_release);	//other processes must not see the magic before the rest of the header
+		m_ptrHeader->Magic = SHARED_MEMORY_POOL_MAGIC;
+	}
+
+	//
+	//CalculateNeededChunks
+	//
+	std::size_t SharedMemoryPool::CalculateNeededChunks(const std::size_t &sMemorySize)
+	{
+		std::size_t sMemoryChunkSize = m_ptrHeader->MemoryChunkSize;
+		return ((sMemorySize / sMemoryChunkSize) + ((sMemorySize % sMemoryChunkSize) ? 1 : 0));
+	}
+
+	//
+	//FindChunkSuitableToHoldMemory
+	//
+	SharedMemoryChunk *SharedMemoryPool::FindChunkSuitableToHoldMemory(const std::size_t &sMemorySize)
+	{
+		//Same search as "MemoryPool::FindFreeChunksInSegment()" : Start at the cursor pos and wrap around to the first Chunk once.
+		//Used blocks are skipped as a whole, all Chunks after the high-water mark are free. (Must be called with the Lock held)
+		std::size_t sNeededChunks = CalculateNeededChunks(sMemorySize);
+		std::size_t sChunkCount = m_ptrHeader->MemoryChunkCount;
+		std::size_t sStartChunk = ((m_ptrHeader->CursorChunk - m_ptrHeader->Chunks) / sizeof(SharedMemoryChunk));
+
+		for (int iPass = 0; iPass < 2; iPass++)
+		{
+			std::size_t i = ((iPass == 0) ? sStartChunk : 0);
+			while (i < sChunkCount)
+			{
+				std::size_t sInitializedChunks = m_ptrHeader->InitializedChunks;
+				SharedMemoryChunk *ptrChunk = GetChunkAt(i);
+				if (i >= sInitializedChunks)
+				{
+					if ((sChunkCount - i) < sNeededChunks)
+					{
+						break;	//not enough memory left
+					}
+					InitializeChunks(i + sNeededChunks);
+					m_ptrHeader->CursorChunk = m_ptrHeader->Chunks + (i * sizeof(SharedMemoryChunk));
+					return ptrChunk;
+				}
+
+				if (ptrChunk->DataSize < sMemorySize)
+				{
+					break;	//not enough memory left
+				}
+
+				if (ptrChunk->UsedSize == 0)
+				{
+					std::size_t sFreeChunks = 1;
+					while ((sFreeChunks < sNeededChunks) && (((i + sFreeChunks) >= sInitializedChunks) || (GetChunkAt(i + sFreeChunks)->UsedSize == 0)))
+					{
+						sFreeChunks++;
+					}
+
+					if (sFreeChunks == sNeededChunks)
+					{
+						InitializeChunks(i + sNeededChunks);
+						m_ptrHeader->CursorChunk = m_ptrHeader->Chunks + (i * sizeof(SharedMemoryChunk));
+						return ptrChunk;
+					}
+					i += sFreeChunks;
+				}
+				else
+				{
+					i += CalculateNeededChunks(ptrChunk->UsedSize);
+				}
+			}
+		}
+
+		return NULL;
+	}
+
+	//
+	//InitializeChunks
+	//
+	void SharedMemoryPool::InitializeChunks(std::size_t sChunkCount)
+	{
+		std::size_t sMemoryChunkSize = m_ptrHeader->MemoryChunkSize;
+		for (std::size_t i = m_ptrHeader->InitializedChunks; i < sChunkCount; i++)
+		{
+			SharedMemoryChunk *ptrChunk = GetChunkAt(i);
+			ptrChunk->Data = m_ptrHeader->Data + (i * sMemoryChunkSize);
+			ptrChunk->DataSize = ((m_ptrHeader->MemoryChunkCount - i) * sMemoryChunkSize);
+			ptrChunk->UsedSize = 0;
+			ptrChunk->Next = 0;
+			if (i > 0)
+			{
+				GetChunkAt(i - 1)->Next = m_ptrHeader->Chunks + (i * sizeof(SharedMemoryChunk));
+			}
+		}
+
+		if (sChunkCount > m_ptrHeader->InitializedChunks)
+		{
+			m_ptrHeader->InitializedChunks = sChunkCount;
+		}
+	}
+
+	//
+	//GetChunk
+	//
+	SharedMemoryChunk *SharedMemoryPool::GetChunk(const TOffset &sChunkOffset)
+	{
+		if (sChunkOffset == 0)
+		{
+			return NULL;
+		}
+		return (SharedMemoryChunk*)(m_ptrRegion + sChunkOffset);
+	}
+
+	//
+	//GetChunkAt
+	//
+	SharedMemoryChunk *SharedMemoryPool::GetChunkAt(std::size_t sChunkIndex)
+	{
+		return (SharedMemoryChunk*)(m_ptrRegion + m_ptrHeader->Chunks + (sChunkIndex * sizeof(SharedMemoryChunk)));
+	}
+
+	//
+	//InitializeLock
+	//
+	bool SharedMemoryPool::InitializeLock()
+	{
+#ifdef _WIN32
+		return true;	//the mutex is created with the mapping (see "MapRegion()")
+#else
+		//A robust mutex reports the death of its owner to the next process locking it, instead of blocking it forever
+		pthread_mutexattr_t mutexAttributes;
+		if (pthread_mutexattr_init(&mutexAttributes) != 0)
+		{
+			return false;
+		}
+		bool bInitialized = ((pthread_mutexattr_setpshared(&mutexAttributes, PTHREAD_PROCESS_SHARED) == 0) &&
+			(pthread_mutexattr_setrobust(&mutexAttributes, PTHREAD_MUTEX_ROBUST) == 0) &&
+			(pthread_mutex_init(&(m_ptrHeader->Mutex), &mutexAttributes) == 0));
+		pthread_mutexattr_destroy(&mutexAttributes);
+		return bInitialized;
+#endif
+	}
+
+	//
+	//Lock
+	//
+	void SharedMemoryPool::Lock()
+	{
+#ifdef _WIN32
+		bool bOwnerDied = (WaitForSingleObject((HANDLE)m_hMutex, INFINITE) == WAIT_ABANDONED);
+#else
+		int iResult = pthread_mutex_lock(&(m_ptrHeader->Mutex));
+		bool bOwnerDied = (iResult == EOWNERDEAD);
+		if (bOwnerDied)
+		{
+			pthread_mutex_consistent(&(m_ptrHeader->Mutex));
+		}
+		assert(((iResult == 0) || (bOwnerDied)) && "ERROR : The Lock of the SharedMemoryPool is not usable");
+#endif
+		if (bOwnerDied)
+		{
+			RepairAfterOwnerDied();
+		}
+	}
+
+	//
+	//Unlock
+	//
+	void SharedMemoryPool::Unlock()
+	{
+#ifdef _WIN32
+		ReleaseMutex((HANDLE)m_hMutex);
+#else
+		pthread_mutex_unlock(&(m_ptrHeader->Mutex));
+#endif
+	}
+
+	//
+	//RepairAfterOwnerDied
+	//
+	void SharedMemoryPool::RepairAfterOwnerDied()
+	{
+		//A process died while holding the Lock (e.g. killed in "GetMemory()"), so the counters may be half-updated. Only the first
+		//Chunk of a block holds its "UsedSize" (the others are 0), so every block is either allocated or free, and the counters
+		//can be rebuilt from the Chunks. Chunks beyond the high-water mark are initialized again, when they are handed out.
+		std::size_t sUsedMemoryPoolSize = 0;
+		std::size_t sObjectCount = 0;
+		std::size_t i = 0;
+		while (i < m_ptrHeader->InitializedChunks)
+		{
+			std::size_t sUsedSize = GetChunkAt(i)->UsedSize;
+			if (sUsedSize)
+			{
+				sUsedMemoryPoolSize += sUsedSize;
+				sObjectCount++;
+				i += CalculateNeededChunks(sUsedSize);
+			}
+			else
+			{
+				i++;
+			}
+		}
+		m_ptrHeader->UsedMemoryPoolSize = sUsedMemoryPoolSize;
+		m_ptrHeader->ObjectCount = sObjectCount;
+		m_ptrHeader->CursorChunk = m_ptrHeader->Chunks;
+		m_ptrHeader->Generation++;	//a running "Checkpoint()" must not mark the repaired pool clean
+	}
+}
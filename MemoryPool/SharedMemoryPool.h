@@ -0,0 +1,133 @@
+//
+//SharedMemoryPool.h
+//
+
+#ifndef _SHAREDMEMORYPOOL_H
+#define _SHAREDMEMORYPOOL_H
+
+#include "MemoryBlock.h"
+#include "SharedMemoryChunk.h"
+#include "MemoryPool.h"
+
+namespace MemoryPool
+{
+	//class SharedMemoryPool
+	//A MemoryPool variant, which lives in a named shared memory object, so several processes on the same machine can allocate 
+	//from it. Memory is passed between processes as an offset (see "GetOffset()" / "GetPointer()"), and read without copying.
+	//The size of the pool is fixed at creation, "GetMemory()" returns NULL when the pool is full.
+	//The pool can also be backed by a file (see "CreateMappedFile()"). Nothing in the region depends on the address it is
+	//mapped at, so a restarted process gets all live allocations back by mapping the file again (see "Checkpoint()").
+
+	class SharedMemoryPool : public MemoryBlock
+	{
+	public:
+		SharedMemoryPool();
+
+		//Destructor : Unmaps the pool. The shared memory object itself stays until "Remove()" is called.
+		virtual ~SharedMemoryPool();
+
+		//Create :					Create a new named shared memory object and set up an empty pool in it.
+		//<param> strName :			Name of the shared memory object, e.g. "/MyPool".
+		//<param> sMemoryPoolSize :	The Size (in Bytes) of memory which can be handed out.
+		//<param> sMemoryChunkSize :The Size (in Bytes) each SharedMemoryChunk can Manage.
+		//<Return> :				true on success, false otherwise (e.g. an object with this name exists already)
+		bool Create(const std::string &strName, const std::size_t &sMemoryPoolSize, const std::size_t &sMemoryChunkSize = DEFAULT_MEMORY_CHUNK_SIZE);
+
+		//Open :					Map a pool created by another process (via "Create()").
+		//<param> strName :			Name of the shared memory object.
+		//<Return> :				true on success, false otherwise
+		bool Open(const std::string &strName);
+
+		//Close :					Unmap the pool. All pointers into the pool become invalid, offsets stay valid. A file-backed pool is checkpointed first.
+		void Close();
+
+		//CreateMappedFile :		Create a new file and set up an empty pool in it. The pool is mapped from the file, so it survives the process.
+		//<param> strFileName :		Name of the file, it must not exist yet.
+		//<param> sMemoryPoolSize :	The Size (in Bytes) of memory which can be handed out.
+		//<param> sMemoryChunkSize :The Size (in Bytes) each SharedMemoryChunk can Manage.
+		//<Return> :				true on success, false otherwise
+		bool CreateMappedFile(const std::string &strFileName, const std::size_t &sMemoryPoolSize, const std::size_t &sMemoryChunkSize = DEFAULT_MEMORY_CHUNK_SIZE);
+
+		//OpenMappedFile :			Map a pool file created via "CreateMappedFile()" again, e.g. after a restart. Takes O(1), nothing is rebuilt.
+		//							Only a clean file is opened, i.e. the pool was not changed after its last "Checkpoint()" / "Close()".
+		//							(Note! This resets the Lock of the pool, which may have been held by a crashed process. Don't open a file
+		//							which is still used by a running process, use "Open()" on a shared memory object for that.)
+		//<param> strFileName :		Name of the file.
+		//<Return> :				true on success, false otherwise (e.g. the file is no pool, or the pool was changed after its last checkpoint)
+		bool OpenMappedFile(const std::string &strFileName);
+
+		//Checkpoint :				Write the pool to its file and mark the file clean, so "OpenMappedFile()" accepts it. The allocations are
+		//							consistent as of the checkpoint, until the next "GetMemory()" / "FreeMemory()" / "SetRootOffset()" marks
+		//							the file dirty again. Data written into allocations is not tracked, it is in the file as of the checkpoint
+		//							at the latest. The file is flushed without holding the Lock, the other processes keep allocating meanwhile.
+		//							The first change after a checkpoint flushes the header page, to mark the file dirty before the change can
+		//							reach it. The changing process waits for that flush, the others are not stalled (it is done without the Lock).
+		//<Return> :				true on success, false otherwise (e.g. the pool changed during every flush)
+		bool Checkpoint();
+
+		//SetRootOffset :			Store the offset of the application's root object (e.g. an index) in the pool, to find it again after "OpenMappedFile()".
+		void SetRootOffset(const TOffset &sOffset);
+
+		//GetRootOffset :			return the offset stored via "SetRootOffset()", or 0 if none was set.
+		TOffset GetRootOffset();
+
+		//Remove :					Remove the name of a shared memory object. Processes which mapped it already can still use it.
+		//<param> strName :			Name of the shared memory object.
+		//<Return> :				true on success, false otherwise
+		static bool Remove(const std::string &strName);
+
+		//GetMemory :				Get "sMemorySize" Bytes from the Memory Pool.
+		//<param> sMemorySize :		Sizes (in Bytes) of Memory.
+		//<Return> :				Pointer to a Memory-Block of "sMemorySize" Bytes, or NULL if the pool is full or not mapped.
+		virtual void *GetMemory(const std::size_t &sMemorySize);
+
+		//FreeMemory :				Free the allocated memory again! The memory may have been allocated by another process.
+		//<param> ptrMemoryBlock :	Pointer to a Block of Memory, which is to be freed (previoulsy allocated via "GetMemory()").
+		//<param> sMemorySize :		Sizes (in Bytes) of Memory.
+		virtual void FreeMemory(void *ptrMemoryBlock, const std::size_t &sMemoryBlockSize);
+
+		//GetOffset :				Translate a pointer into this process' mapping to an offset, which is valid in every process.
+		//<Return> :				Offset of the pointer, or 0 if the pointer is not inside the pool.
+		TOffset GetOffset(void *ptrPointer);
+
+		//GetPointer :				Translate an offset (e.g. received from another process) to a pointer into this process' mapping.
+		//<Return> :				Pointer to the memory, or NULL if the offset is not inside the pool.
+		void *GetPointer(const TOffset &sOffset);
+
+		//IsValidPointer :			Check, if a Pointer is in the Memory-Pool.(Note! This Checks only if a pointer is inside the Memory-Pool, and not if the Memory contains meaningfull data.)
+		bool IsValidPointer(void *ptrPointer);
+
+	private:
+		bool CreateRegion(const std::string &strName, const std::size_t &sMemoryPoolSize, const std::size_t &sMemoryChunkSize, bool bFile);	//Create a shared memory object / file and set up an empty pool in it.
+		bool OpenRegion(const std::string &strName, bool bFile);	//Map an existing shared memory object / file and check that it contains a pool.
+		bool MapRegion(const std::string &strName, const std::size_t &sRegionSize, bool bCreate, bool bFile);	//Create/Open the shared memory object (or file) and map "sRegionSize" Bytes of it (0 = the whole object).
+		void InitializeRegion(const std::size_t &sMemoryChunkSize, const std::size_t &sChunkCount);	//Set up the header of a new region
+		
+		std::size_t CalculateNeededChunks(const std::size_t &sMemorySize);	//return the Number of SharedMemoryChunks needed to Manage "sMemorySize" Bytes.
+		SharedMemoryChunk *FindChunkSuitableToHoldMemory(const std::size_t &sMemorySize);	//return the first of enough free, contiguous Chunks, or NULL, if none was found.
+		void InitializeChunks(std::size_t sChunkCount);	//Initialize the Chunks up to "sChunkCount" (raises the high-water mark)
+		
+		SharedMemoryChunk *GetChunk(const TOffset &sChunkOffset);	//return the Chunk at the given Offset
+		SharedMemoryChunk *GetChunkAt(std::size_t sChunkIndex);		//return the Chunk with the given index
+
+		void LockForModification();	//Acquire the Lock for a change of the chunks / header, a clean file is marked dirty in the file first (see "Checkpoint()")
+		bool SyncRegion(const std::size_t &sSize);	//Flush the first "sSize" Bytes of the region to its file
+		void Unmap();	//Unmap the region and close its handles, without checkpointing it
+
+		bool InitializeLock();	//Set up the Lock of the region (a new one, or one in a reopened file)
+		void Lock();	//Acquire the Lock of the region (shared by all processes), repairs the pool if its last owner died while holding it
+		void Unlock();	//Release the Lock of the region
+		void RepairAfterOwnerDied();	//Rebuild the counters of the header from the Chunks (the Lock must be held)
+
+		TByte *m_ptrRegion;					//Start of the region in this process
+		SharedMemoryHeader *m_ptrHeader;	//Header at the start of the region
+		std::size_t m_sMappedSize;			//number of Bytes mapped in this process
+		bool m_bFile;						//true, if the region is mapped from a file
+#ifdef _WIN32
+		void *m_hMapping;					//Handle of the file mapping object (the object is destroyed with the last handle)
+		void *m_hFile;						//Handle of the file, if the region is mapped from a file (needed to flush it)
+		void *m_hMutex;						//Handle of the (named) mutex, which is the Lock of the region
+#endif
+	};
+}
+#endif	//_SHAREDMEMORYPOOL_H
@@ -5,6 +5,18 @@
 
 #include "HeaderFiles.h"
 #include "MemoryPool.h"
+#include "SharedMemoryPool.h"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sched.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 MemoryPool::MemoryPool *g_ptrMemPool = NULL;	//Global MemoryPool
 unsigned int TestCount = 50000000;				//allocations 
@@ -190,6 +202,811 @@ void TestAllocationSpeedArrayHeap()
 	std::cerr << "Result for Heap(Array-Test)    : " << totaltime << " s" << std::endl;
 }
 
+//
+//TestPoolCreationSpeed
+//
+void TestPoolCreationSpeed()
+{
+	const std::size_t sPoolSize = 256 * 1024 * 1024;
+	std::cerr << "Creating large MemoryPool (Pool Size : " << sPoolSize << ")...";
+	clock_t start, finish;
+	double totaltime;
+	start = clock();
+	MemoryPool::MemoryPool *ptrMemPool = new MemoryPool::MemoryPool(sPoolSize);
+	char *ptrArray = (char *)ptrMemPool->GetMemory(ArraySize);
+	ptrMemPool->FreeMemory(ptrArray, ArraySize);
+	delete ptrMemPool;
+	finish = clock();
+	totaltime = (double)(finish - start) / CLOCKS_PER_SEC;
+	std::cerr << "OK" << std::endl;
+
+	std::cerr << "Result for MemPool(Creation) : " << totaltime << " s" << std::endl;
+}
+
+//
+//TestLargeRequests
+//
+bool TestLargeRequest(const std::size_t &sMemoryChunkSize, const std::size_t &sMemorySize)
+{
+	//Allocate "sMemorySize" Bytes and check, that the next allocation doesn't overlap it
+	MemoryPool::MemoryPool memPool(sMemorySize + (64 * sMemoryChunkSize), sMemoryChunkSize, sMemoryChunkSize);
+	unsigned char *ptrLarge = (unsigned char*)memPool.GetMemory(sMemorySize);
+	unsigned char *ptrSmall = (unsigned char*)memPool.GetMemory(1);
+	bool bOk = (ptrLarge != NULL) && (ptrSmall != NULL);	//NULL, if the OS refused the memory (e.g. no overcommit or a ulimit)
+	if (bOk)
+	{
+		ptrLarge[sMemorySize - 1] = 0x55;
+		ptrSmall[0] = 0xAA;
+		bOk = ((ptrSmall >= (ptrLarge + sMemorySize)) || ((ptrSmall + 1) <= ptrLarge)) && (ptrLarge[sMemorySize - 1] == 0x55);
+	}
+	if (ptrSmall)
+	{
+		memPool.FreeMemory(ptrSmall, 1);
+	}
+	if (ptrLarge)
+	{
+		memPool.FreeMemory(ptrLarge, sMemorySize);
+	}
+	return bOk;
+}
+
+void TestLargeRequests()
+{
+	std::cerr << "Allocating large Memory-Blocks...";
+	const std::size_t sFloatPrecisionLimit = ((std::size_t)1) << 24;	//a float can't represent all sizes above 2^24
+	bool bOk = TestLargeRequest(128, sFloatPrecisionLimit + 1) && TestLargeRequest(100, sFloatPrecisionLimit + 1);
+	if (sizeof(std::size_t) >= 8)
+	{
+		//Pools and requests larger than 4 GB. Big chunks keep the chunk metadata small, the data pages are never touched.
+		const std::size_t sLargeSize = (((std::size_t)1) << 32) + 12345;
+		bOk = bOk && TestLargeRequest(1024 * 1024, sLargeSize) && TestLargeRequest(1000 * 1000, sLargeSize);
+	}
+
+	//Requests whose size wraps around, when rounded up to whole chunks, fail instead of returning a small block
+	MemoryPool::MemoryPool memPool128(MemoryPool::DEFAULT_MEMORY_POOL_SIZE, 128);
+	MemoryPool::MemoryPool memPool100(MemoryPool::DEFAULT_MEMORY_POOL_SIZE, 100);
+	bOk = bOk && (memPool128.GetMemory((std::size_t)-1) == NULL) && (memPool100.GetMemory((std::size_t)-1) == NULL);
+	bOk = bOk && (memPool128.GetHandle((std::size_t)-1) == MemoryPool::INVALID_MEMORY_HANDLE);
+	std::cerr << (bOk ? "OK" : "FAILED") << std::endl;
+}
+
+//
+//TestZeroSizeRequests
+//
+void TestZeroSizeRequests()
+{
+	std::cerr << "Allocating zero-size Memory-Blocks...";
+	MemoryPool::MemoryPool memPool;
+	void *ptrFirst = memPool.GetMemory(0);
+	void *ptrSecond = memPool.GetMemory(0);
+	void *ptrThird = memPool.GetMemory(1);
+	MemoryPool::MemoryHandle hMemory = memPool.GetHandle(0);
+	void *ptrHandle = memPool.PinHandle(hMemory);
+
+	//Every request has a valid pointer of its own
+	bool bOk = (ptrFirst != NULL) && (ptrSecond != NULL) && (ptrThird != NULL) && (ptrHandle != NULL);
+	bOk = bOk && memPool.IsValidPointer(ptrFirst) && memPool.IsValidPointer(ptrSecond) && memPool.IsValidPointer(ptrThird) && memPool.IsValidPointer(ptrHandle);
+	bOk = bOk && (ptrFirst != ptrSecond) && (ptrFirst != ptrThird) && (ptrSecond != ptrThird) && (ptrHandle != ptrFirst) && (ptrHandle != ptrSecond) && (ptrHandle != ptrThird);
+
+	memPool.UnpinHandle(hMemory);
+	memPool.FreeHandle(hMemory);
+	memPool.FreeMemory(ptrThird, 1);
+	memPool.FreeMemory(ptrSecond, 0);
+	memPool.FreeMemory(ptrFirst, 0);
+	std::cerr << (bOk ? "OK" : "FAILED") << std::endl;
+}
+
+//
+//TestHandleCompaction
+//
+void TestHandleCompaction()
+{
+	std::cerr << "Compacting Handle-Memory...";
+	MemoryPool::MemoryPool memPool(1024, 128, 1024);	//every growth adds a small Segment, so the Handles are spread over many Segments
+	const unsigned int uiHandleCount = 64;
+	const std::size_t sHandleSize = 200;
+	MemoryPool::MemoryHandle hMemory[uiHandleCount];
+
+	for (unsigned int i = 0; i < uiHandleCount; i++)
+	{
+		hMemory[i] = memPool.GetHandle(sHandleSize);
+		memset(memPool.PinHandle(hMemory[i]), (int)i, sHandleSize);
+		memPool.UnpinHandle(hMemory[i]);
+	}
+	void *ptrRaw = memPool.GetMemory(sHandleSize);	//raw Memory is never moved
+
+	for (unsigned int i = 1; i < uiHandleCount; i += 2)	//leave a hole after every Handle
+	{
+		memPool.FreeHandle(hMemory[i]);
+	}
+
+	void *ptrPinned = memPool.PinHandle(hMemory[uiHandleCount - 2]);	//pinned Memory is never moved
+	MemoryPool::CompactionStats stats = memPool.Compact(((std::size_t)-1));
+
+	bool bOk = (memPool.PinHandle(hMemory[uiHandleCount - 2]) == ptrPinned) && memPool.IsValidPointer(ptrRaw);
+	memPool.UnpinHandle(hMemory[uiHandleCount - 2]);
+	memPool.UnpinHandle(hMemory[uiHandleCount - 2]);
+	for (unsigned int i = 0; i < uiHandleCount; i += 2)
+	{
+		unsigned char *ptrData = (unsigned char*)memPool.PinHandle(hMemory[i]);
+		for (std::size_t j = 0; j < sHandleSize; j++)
+		{
+			bOk = bOk && (ptrData[j] == (unsigned char)i);
+		}
+		memPool.UnpinHandle(hMemory[i]);
+		memPool.FreeHandle(hMemory[i]);
+	}
+	memPool.FreeMemory(ptrRaw, sHandleSize);
+	std::cerr << (bOk ? "OK" : "FAILED") << std::endl;
+
+	std::cerr << "Result for Compact : " << stats.BytesMoved << " Bytes moved, " << stats.BytesReleased << " Bytes (" << stats.SegmentsReleased 
+		<< " Segments) released, Fragmentation " << stats.FragmentationBefore << " -> " << stats.FragmentationAfter << std::endl;
+}
+
+#ifndef _WIN32
+//
+//ReadFully / WriteFully : pipe helpers, a pipe may transfer less than requested
+//
+bool ReadFully(int iFileDescriptor, void *ptrBuffer, std::size_t sSize)
+{
+	char *ptrData = (char*)ptrBuffer;
+	while (sSize > 0)
+	{
+		ssize_t iRead = read(iFileDescriptor, ptrData, sSize);
+		if (iRead <= 0)
+		{
+			return false;
+		}
+		ptrData += iRead;
+		sSize -= (std::size_t)iRead;
+	}
+	return true;
+}
+
+bool WriteFully(int iFileDescriptor, const void *ptrBuffer, std::size_t sSize)
+{
+	const char *ptrData = (const char*)ptrBuffer;
+	while (sSize > 0)
+	{
+		ssize_t iWritten = write(iFileDescriptor, ptrData, sSize);
+		if (iWritten <= 0)
+		{
+			return false;
+		}
+		ptrData += iWritten;
+		sSize -= (std::size_t)iWritten;
+	}
+	return true;
+}
+
+//
+//GetSharedMemory : retry until the other process has freed enough memory
+//
+void *GetSharedMemory(MemoryPool::SharedMemoryPool &memPool, const std::size_t &sMemorySize)
+{
+	void *ptrMemory = NULL;
+	while (!(ptrMemory = memPool.GetMemory(sMemorySize)))
+	{
+		sched_yield();
+	}
+	return ptrMemory;
+}
+#endif
+
+//
+//TestSharedMemoryPool
+//
+void TestSharedMemoryPool()
+{
+	std::cerr << "Sharing Memory between two Processes...";
+#ifdef _WIN32
+	std::cerr << "SKIPPED (needs fork())" << std::endl;
+#else
+	const char *strPoolName = "/MemoryPoolTest";
+	const unsigned int uiMessageCount = 20000;
+	MemoryPool::SharedMemoryPool::Remove(strPoolName);	//left over from a crashed run
+
+	MemoryPool::SharedMemoryPool memPool;
+	int iPipe[2];
+	if ((!memPool.Create(strPoolName, 4 * 1024 * 1024)) || (pipe(iPipe) != 0))
+	{
+		std::cerr << "FAILED" << std::endl;
+		return;
+	}
+
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		//Child : allocate the messages from its own mapping and pass the offsets to the parent, which frees them
+		close(iPipe[0]);
+		MemoryPool::SharedMemoryPool childPool;
+		bool bOk = childPool.Open(strPoolName);
+		for (unsigned int i = 0; (i < uiMessageCount) && bOk; i++)
+		{
+			std::size_t sMessageSize = 1 + ((i * 7919) % 4000);
+			void *ptrMessage = GetSharedMemory(childPool, sMessageSize);
+			memset(ptrMessage, (int)(i & 0xFF), sMessageSize);
+			MemoryPool::TOffset sOffset = childPool.GetOffset(ptrMessage);
+			bOk = WriteFully(iPipe[1], &sOffset, sizeof(sOffset));
+		}
+		close(iPipe[1]);
+		_exit(bOk ? 0 : 1);
+	}
+
+	close(iPipe[1]);
+	bool bOk = (pid > 0);
+	MemoryPool::TOffset sOffset = 0;
+	for (unsigned int i = 0; bOk && (i < uiMessageCount); i++)
+	{
+		bOk = ReadFully(iPipe[0], &sOffset, sizeof(sOffset));
+		std::size_t sMessageSize = 1 + ((i * 7919) % 4000);
+		unsigned char *ptrMessage = (unsigned char*)memPool.GetPointer(sOffset);
+		bOk = bOk && ptrMessage;
+		for (std::size_t j = 0; bOk && (j < sMessageSize); j++)
+		{
+			bOk = (ptrMessage[j] == (unsigned char)(i & 0xFF));
+		}
+		if (bOk)
+		{
+			memPool.FreeMemory(ptrMessage, sMessageSize);
+		}
+	}
+	close(iPipe[0]);
+
+	int iStatus = 1;
+	if (pid > 0)
+	{
+		waitpid(pid, &iStatus, 0);
+	}
+	bOk = bOk && WIFEXITED(iStatus) && (WEXITSTATUS(iStatus) == 0);
+	memPool.Close();
+	MemoryPool::SharedMemoryPool::Remove(strPoolName);
+	std::cerr << (bOk ? "OK" : "FAILED") << std::endl;
+#endif
+}
+
+//
+//TestSharedMemoryOwnerDied
+//
+void TestSharedMemoryOwnerDied()
+{
+	std::cerr << "Recovering from a Process killed while holding the Lock...";
+#ifdef _WIN32
+	std::cerr << "SKIPPED (needs fork())" << std::endl;
+#else
+	const char *strPoolName = "/MemoryPoolOwnerDiedTest";
+	const std::size_t sMessageSize = 100;
+	MemoryPool::SharedMemoryPool::Remove(strPoolName);	//left over from a crashed run
+
+	//The child spends most of its time holding the Lock, so some of the kills hit it there
+	MemoryPool::SharedMemoryPool memPool;
+	bool bOk = memPool.Create(strPoolName, 1024 * 1024);
+	for (unsigned int uiRound = 0; bOk && (uiRound < 20); uiRound++)
+	{
+		pid_t pid = fork();
+		if (pid == 0)
+		{
+			MemoryPool::SharedMemoryPool childPool;
+			bool bOpened = childPool.Open(strPoolName);
+			while (bOpened)
+			{
+				childPool.FreeMemory(GetSharedMemory(childPool, sMessageSize), sMessageSize);
+			}
+			_exit(1);
+		}
+		usleep(1000 * (1 + (uiRound % 5)));
+		bOk = (pid > 0) && (kill(pid, SIGKILL) == 0) && (waitpid(pid, NULL, 0) == pid);
+
+		//The pool keeps working (the Lock held by the killed process would block it forever otherwise)
+		void *ptrMessage = (bOk ? memPool.GetMemory(sMessageSize) : NULL);
+		bOk = (ptrMessage != NULL);
+		if (bOk)
+		{
+			memPool.FreeMemory(ptrMessage, sMessageSize);
+		}
+	}
+	memPool.Close();
+	MemoryPool::SharedMemoryPool::Remove(strPoolName);
+	std::cerr << (bOk ? "OK" : "FAILED") << std::endl;
+#endif
+}
+
+//
+//TestSharedMemoryThroughput
+//
+void TestSharedMemoryThroughput()
+{
+#ifndef _WIN32
+	const char *strPoolName = "/MemoryPoolBenchmark";
+	const unsigned int uiMessageCount = 20000;
+	const std::size_t sMessageSize = 64 * 1024;
+	std::cerr << "Passing Messages between two Processes (Message Size : " << sMessageSize << ")...";
+
+	//Pipe : every message is copied into the pipe and out of it again
+	int iPipe[2];
+	if (pipe(iPipe) != 0)
+	{
+		std::cerr << "FAILED" << std::endl;
+		return;
+	}
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		close(iPipe[0]);
+		char *ptrMessage = (char*)malloc(sMessageSize);
+		for (unsigned int i = 0; i < uiMessageCount; i++)
+		{
+			memset(ptrMessage, (int)(i & 0xFF), sMessageSize);
+			WriteFully(iPipe[1], ptrMessage, sMessageSize);
+		}
+		free(ptrMessage);
+		_exit(0);
+	}
+	close(iPipe[1]);
+	unsigned char *ptrBuffer = (unsigned char*)malloc(sMessageSize);
+	unsigned long ulPipeSum = 0;
+	for (unsigned int i = 0; i < uiMessageCount; i++)
+	{
+		ReadFully(iPipe[0], ptrBuffer, sMessageSize);
+		ulPipeSum += ptrBuffer[sMessageSize - 1];
+	}
+	free(ptrBuffer);
+	close(iPipe[0]);
+	waitpid(pid, NULL, 0);
+	double dPipeTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	//SharedMemoryPool : only the offset goes through the pipe, the message is read in place
+	MemoryPool::SharedMemoryPool::Remove(strPoolName);
+	MemoryPool::SharedMemoryPool memPool;
+	if ((!memPool.Create(strPoolName, 64 * sMessageSize, 4096)) || (pipe(iPipe) != 0))
+	{
+		std::cerr << "FAILED" << std::endl;
+		return;
+	}
+	start = std::chrono::steady_clock::now();
+	pid = fork();
+	if (pid == 0)
+	{
+		close(iPipe[0]);
+		MemoryPool::SharedMemoryPool childPool;
+		childPool.Open(strPoolName);
+		for (unsigned int i = 0; i < uiMessageCount; i++)
+		{
+			void *ptrMessage = GetSharedMemory(childPool, sMessageSize);
+			memset(ptrMessage, (int)(i & 0xFF), sMessageSize);
+			MemoryPool::TOffset sOffset = childPool.GetOffset(ptrMessage);
+			WriteFully(iPipe[1], &sOffset, sizeof(sOffset));
+		}
+		_exit(0);
+	}
+	close(iPipe[1]);
+	unsigned long ulPoolSum = 0;
+	for (unsigned int i = 0; i < uiMessageCount; i++)
+	{
+		MemoryPool::TOffset sOffset = 0;
+		ReadFully(iPipe[0], &sOffset, sizeof(sOffset));
+		unsigned char *ptrMessage = (unsigned char*)memPool.GetPointer(sOffset);
+		ulPoolSum += ptrMessage[sMessageSize - 1];
+		memPool.FreeMemory(ptrMessage, sMessageSize);
+	}
+	close(iPipe[0]);
+	waitpid(pid, NULL, 0);
+	double dPoolTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	memPool.Close();
+	MemoryPool::SharedMemoryPool::Remove(strPoolName);
+	std::cerr << ((ulPipeSum == ulPoolSum) ? "OK" : "FAILED") << std::endl;
+
+	std::cerr << "Result for Pipe(Copy)           : " << dPipeTime << " s" << std::endl;
+	std::cerr << "Result for SharedMemoryPool     : " << dPoolTime << " s" << std::endl;
+#endif
+}
+
+//
+//TestPersistentPool
+//
+typedef struct PersistentNode
+{
+	MemoryPool::TOffset Next;	//Offset of the next node, a pointer would be meaningless after a restart
+	unsigned int Value;
+}PersistentNode;
+
+void TestPersistentPool()
+{
+	std::cerr << "Restoring a MemoryPool from a File...";
+	const char *strFileName = "MemoryPool.snapshot";
+	const unsigned int uiNodeCount = 100000;
+	remove(strFileName);	//left over from a crashed run
+
+	//First "run" : build a list inside the file-backed pool and take a snapshot
+	MemoryPool::SharedMemoryPool *ptrMemPool = new MemoryPool::SharedMemoryPool();
+	bool bOk = ptrMemPool->CreateMappedFile(strFileName, 2 * uiNodeCount * sizeof(PersistentNode), sizeof(PersistentNode));
+	MemoryPool::TOffset sHead = 0;
+	for (unsigned int i = 0; bOk && (i < uiNodeCount); i++)
+	{
+		PersistentNode *ptrNode = (PersistentNode*)ptrMemPool->GetMemory(sizeof(PersistentNode));
+		bOk = (ptrNode != NULL);
+		if (bOk)
+		{
+			ptrNode->Next = sHead;
+			ptrNode->Value = i;
+			sHead = ptrMemPool->GetOffset(ptrNode);
+		}
+	}
+	if (bOk)
+	{
+		ptrMemPool->SetRootOffset(sHead);
+		bOk = ptrMemPool->Checkpoint();
+	}
+	delete ptrMemPool;
+
+	//Second "run" : map the file again, the list is available without rebuilding it
+	clock_t start, finish;
+	start = clock();
+	ptrMemPool = new MemoryPool::SharedMemoryPool();
+	bOk = bOk && ptrMemPool->OpenMappedFile(strFileName);
+	finish = clock();
+	double totaltime = (double)(finish - start) / CLOCKS_PER_SEC;
+
+	unsigned int uiExpectedValue = uiNodeCount;
+	MemoryPool::TOffset sOffset = (bOk ? ptrMemPool->GetRootOffset() : 0);
+	while (bOk && sOffset)
+	{
+		PersistentNode *ptrNode = (PersistentNode*)ptrMemPool->GetPointer(sOffset);
+		bOk = (ptrNode != NULL) && (ptrNode->Value == --uiExpectedValue);
+		if (bOk)
+		{
+			sOffset = ptrNode->Next;
+			ptrMemPool->FreeMemory(ptrNode, sizeof(PersistentNode));
+		}
+	}
+	bOk = bOk && (uiExpectedValue == 0) && (ptrMemPool->GetMemory(sizeof(PersistentNode)) != NULL);	//the restored pool keeps working
+	delete ptrMemPool;	//closing the pool checkpoints it
+
+#ifndef _WIN32
+	//Third "run" : a process which changes the pool and dies before the next checkpoint leaves a dirty file behind
+	pid_t pid = (bOk ? fork() : -1);
+	if (pid == 0)
+	{
+		MemoryPool::SharedMemoryPool *ptrCrashingPool = new MemoryPool::SharedMemoryPool();
+		bool bChildOk = ptrCrashingPool->OpenMappedFile(strFileName) && (ptrCrashingPool->GetMemory(sizeof(PersistentNode)) != NULL);
+		_exit(bChildOk ? 0 : 1);	//"crash" without closing the pool
+	}
+	int iStatus = 0;
+	bOk = bOk && (pid > 0) && (waitpid(pid, &iStatus, 0) == pid) && WIFEXITED(iStatus) && (WEXITSTATUS(iStatus) == 0);
+	ptrMemPool = new MemoryPool::SharedMemoryPool();
+	bOk = bOk && !ptrMemPool->OpenMappedFile(strFileName);
+	delete ptrMemPool;
+#endif
+	remove(strFileName);
+	std::cerr << (bOk ? "OK" : "FAILED") << std::endl;
+
+	std::cerr << "Result for SharedMemoryPool(Restore) : " << totaltime << " s" << std::endl;
+}
+
+//
+//TestHeapProfiler
+//
+void TestHeapProfiler()
+{
+	std::cerr << "Sampling Allocations with the HeapProfiler...";
+	const char *strFileName = "MemoryPool.heap";
+	const unsigned int uiObjectCount = 100000;
+	const std::size_t sObjectSize = 64;
+	MemoryPool::MemoryPool *ptrMemPool = new MemoryPool::MemoryPool();
+	ptrMemPool->EnableHeapProfiler(4096);
+
+	//Keep every second Object alive, these are the "leaks" the profile has to show
+	void **ptrObjects = new void*[uiObjectCount];
+	for (unsigned int i = 0; i < uiObjectCount; i++)
+	{
+		ptrObjects[i] = ptrMemPool->GetMemory(sObjectSize);
+	}
+	for (unsigned int i = 0; i < uiObjectCount; i += 2)
+	{
+		ptrMemPool->FreeMemory(ptrObjects[i], sObjectSize);
+	}
+	bool bOk = ptrMemPool->DumpHeapProfile(strFileName);
+
+	//"heap profile:   <live objects>:  <live bytes> [ <allocated objects>:  <allocated bytes>] @ heap_v2/<rate>"
+	std::ifstream ifProfile(strFileName);
+	std::string strHeader;
+	std::getline(ifProfile, strHeader);
+	unsigned long ulLiveObjects = 0, ulLiveBytes = 0;
+	bOk = bOk && (sscanf(strHeader.c_str(), "heap profile: %lu: %lu", &ulLiveObjects, &ulLiveBytes) == 2);
+	bOk = bOk && (strHeader.find("@ heap_v2/4096") != std::string::npos);
+	//Every sample stands for ~4096 Bytes, the estimate of the live Bytes has to be in the right order of magnitude
+	std::size_t sEstimatedBytes = ulLiveObjects * 4096, sLiveBytes = (uiObjectCount / 2) * sObjectSize;
+	bOk = bOk && (ulLiveBytes == ulLiveObjects * sObjectSize) && (sEstimatedBytes > sLiveBytes / 2) && (sEstimatedBytes < sLiveBytes * 2);
+	ifProfile.close();
+	remove(strFileName);
+
+	for (unsigned int i = 1; i < uiObjectCount; i += 2)
+	{
+		ptrMemPool->FreeMemory(ptrObjects[i], sObjectSize);
+	}
+	delete[] ptrObjects;
+	delete ptrMemPool;
+	std::cerr << (bOk ? "OK" : "FAILED") << std::endl;
+
+	//Overhead of the not sampled allocations, with the default sample interval
+	double dTime[2];
+	for (unsigned int uiRun = 0; uiRun < 2; uiRun++)
+	{
+		ptrMemPool = new MemoryPool::MemoryPool();
+		if (uiRun == 1)
+		{
+			ptrMemPool->EnableHeapProfiler();
+		}
+		clock_t start, finish;
+		start = clock();
+		for (unsigned int i = 0; i < (TestCount / 10); i++)
+		{
+			ptrMemPool->FreeMemory(ptrMemPool->GetMemory(sObjectSize), sObjectSize);
+		}
+		finish = clock();
+		dTime[uiRun] = (double)(finish - start) / CLOCKS_PER_SEC;
+		delete ptrMemPool;
+	}
+
+	//The same number of allocations, alternating between two profiled pools (every profiler keeps its own countdown)
+	MemoryPool::MemoryPool *ptrOtherMemPool = new MemoryPool::MemoryPool();
+	ptrMemPool = new MemoryPool::MemoryPool();
+	ptrMemPool->EnableHeapProfiler();
+	ptrOtherMemPool->EnableHeapProfiler();
+	clock_t start, finish;
+	start = clock();
+	for (unsigned int i = 0; i < (TestCount / 20); i++)
+	{
+		ptrMemPool->FreeMemory(ptrMemPool->GetMemory(sObjectSize), sObjectSize);
+		ptrOtherMemPool->FreeMemory(ptrOtherMemPool->GetMemory(sObjectSize), sObjectSize);
+	}
+	finish = clock();
+	double dAlternatingTime = (double)(finish - start) / CLOCKS_PER_SEC;
+	delete ptrMemPool;
+	delete ptrOtherMemPool;
+
+	std::cerr << "Result for MemoryPool                : " << dTime[0] << " s" << std::endl;
+	std::cerr << "Result for MemoryPool(HeapProfiler)  : " << dTime[1] << " s" << std::endl;
+	std::cerr << "Result for MemoryPool(2 Profilers)   : " << dAlternatingTime << " s" << std::endl;
+}
+
+//
+//TestMemoryLimits
+//
+typedef struct MemoryCache
+{
+	std::vector<void*> Objects;		//cached Objects, which can be freed on memory pressure
+	std::size_t ObjectSize;
+	MemoryPool::MemoryPool *Pool;	//Pool holding the Objects, NULL = the pool calling "ShedMemoryCache()"
+	unsigned int PressureCount;		//number of calls to "ShedMemoryCache()"
+}MemoryCache;
+
+void ShedMemoryCache(MemoryPool::MemoryPool *ptrMemoryPool, MemoryPool::MemoryPressureLevel ePressureLevel, const std::size_t &sMemoryPoolSize, void *ptrUserData)
+{
+	MemoryCache *ptrCache = (MemoryCache*)ptrUserData;
+	ptrCache->PressureCount++;
+	if (ptrCache->Pool)
+	{
+		ptrMemoryPool = ptrCache->Pool;
+	}
+	for (std::size_t i = 0; i < ptrCache->Objects.size(); i++)
+	{
+		ptrMemoryPool->FreeMemory(ptrCache->Objects[i], ptrCache->ObjectSize);
+	}
+	ptrCache->Objects.clear();
+}
+
+void TestMemoryLimits()
+{
+	std::cerr << "Limiting the MemoryPool size...";
+	const std::size_t sObjectSize = 1024;
+	const std::size_t sSoftLimit = 64 * 1024;
+	const std::size_t sHardLimit = 128 * 1024;
+	MemoryPool::MemoryPool *ptrMemPool = new MemoryPool::MemoryPool(MemoryPool::DEFAULT_MEMORY_POOL_SIZE, MemoryPool::DEFAULT_MEMORY_CHUNK_SIZE, 8 * 1024);
+	ptrMemPool->SetMemoryLimits(sSoftLimit, sHardLimit);
+	MemoryCache cache;
+	cache.ObjectSize = sObjectSize;
+	cache.Pool = NULL;
+	cache.PressureCount = 0;
+	ptrMemPool->AddMemoryPressureCallback(ShedMemoryCache, &cache);
+
+	//Fill the cache until the soft limit is crossed : the callback empties the cache, and the pool is trimmed
+	bool bOk = true;
+	while (bOk && (cache.PressureCount == 0))
+	{
+		void *ptrObject = ptrMemPool->GetMemory(sObjectSize);
+		bOk = (ptrObject != NULL);
+		if (bOk)
+		{
+			cache.Objects.push_back(ptrObject);
+		}
+	}
+	bOk = bOk && (cache.Objects.size() == 1) && (ptrMemPool->GetMemoryPoolSize() <= sSoftLimit);
+
+	//Fail fast : requests beyond the hard limit return NULL, instead of growing the pool without bound
+	std::vector<void*> objects;
+	void *ptrObject = NULL;
+	while (bOk && ((ptrObject = ptrMemPool->GetMemory(sObjectSize)) != NULL))
+	{
+		objects.push_back(ptrObject);
+		bOk = (objects.size() <= (sHardLimit / sObjectSize));
+	}
+	bOk = bOk && (ptrMemPool->GetMemoryPoolSize() <= sHardLimit) && (cache.PressureCount > 1) && (ptrMemPool->GetMemory(sHardLimit + 1) == NULL);
+
+	//Wait : a request at the hard limit is served, as soon as another thread frees memory
+	ptrMemPool->SetMemoryLimits(sSoftLimit, sHardLimit, MemoryPool::MEMORY_LIMIT_WAIT, 10000);
+	void *ptrFreedObject = objects.back();
+	objects.pop_back();
+	std::thread freeThread([ptrMemPool, ptrFreedObject, sObjectSize]()
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		ptrMemPool->FreeMemory(ptrFreedObject, sObjectSize);
+	});
+	std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+	ptrObject = ptrMemPool->GetMemory(sObjectSize);
+	double dWaitTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
+	freeThread.join();
+	bOk = bOk && (ptrObject != NULL) && (dWaitTime >= 0.05);
+	if (ptrObject)
+	{
+		objects.push_back(ptrObject);
+	}
+
+	//... or fails after the timeout
+	ptrMemPool->SetMemoryLimits(sSoftLimit, sHardLimit, MemoryPool::MEMORY_LIMIT_WAIT, 100);
+	tStart = std::chrono::steady_clock::now();
+	bOk = bOk && (ptrMemPool->GetMemory(sObjectSize) == NULL);
+	dWaitTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
+	bOk = bOk && (dWaitTime >= 0.09);
+
+	ptrMemPool->RemoveMemoryPressureCallback(ShedMemoryCache, &cache);
+	ShedMemoryCache(ptrMemPool, MemoryPool::MEMORY_PRESSURE_NONE, 0, &cache);
+	for (std::size_t i = 0; i < objects.size(); i++)
+	{
+		ptrMemPool->FreeMemory(objects[i], sObjectSize);
+	}
+	delete ptrMemPool;
+	std::cerr << (bOk ? "OK" : "FAILED") << std::endl;
+}
+
+//
+//TestChildPools
+//
+void TestChildPools()
+{
+	std::cerr << "Releasing Sessions via child pools...";
+	const unsigned int uiSessionCount = 1000;
+	const unsigned int uiObjectsPerSession = 5000;
+	const std::size_t sObjectSize = 64;
+	void **ptrObjects = new void*[uiObjectsPerSession];
+
+	//The Segments of a deleted child are lent to the next one, so the parent does not grow from session to session
+	MemoryPool::MemoryPool *ptrMemPool = new MemoryPool::MemoryPool(MemoryPool::DEFAULT_MEMORY_POOL_SIZE, MemoryPool::DEFAULT_MEMORY_CHUNK_SIZE, 64 * 1024);
+	bool bOk = true;
+	std::size_t sPoolSize = 0;
+	for (unsigned int uiSession = 0; bOk && (uiSession < 3); uiSession++)
+	{
+		MemoryPool::MemoryPool *ptrChildPool = ptrMemPool->CreateChildPool();
+		bOk = (ptrChildPool != NULL);
+		for (unsigned int i = 0; bOk && (i < uiObjectsPerSession); i++)
+		{
+			ptrObjects[i] = ptrChildPool->GetMemory(sObjectSize);
+			bOk = (ptrObjects[i] != NULL) && (!ptrMemPool->IsValidPointer(ptrObjects[i]));	//the Segment is owned by the child now
+			if (bOk)
+			{
+				memset(ptrObjects[i], (int)i, sObjectSize);
+			}
+		}
+		for (unsigned int i = 0; bOk && (i < uiObjectsPerSession); i++)
+		{
+			bOk = (((unsigned char*)ptrObjects[i])[sObjectSize - 1] == (unsigned char)i);
+		}
+		delete ptrChildPool;	//no "FreeMemory()" for the objects of the session
+		if (uiSession == 0)
+		{
+			sPoolSize = ptrMemPool->GetMemoryPoolSize();
+		}
+		bOk = bOk && (ptrMemPool->GetMemoryPoolSize() == sPoolSize);
+	}
+	bOk = bOk && (ptrMemPool->Trim() > 0) && (ptrMemPool->GetMemoryPoolSize() < sPoolSize);	//the spare Segments can be given back to the OS
+	delete ptrMemPool;
+
+	//A child pushing the parent beyond its soft limit : the callback of the parent frees objects of the child, the child must not hold its lock meanwhile
+	ptrMemPool = new MemoryPool::MemoryPool(8 * 1024, MemoryPool::DEFAULT_MEMORY_CHUNK_SIZE, 8 * 1024);
+	ptrMemPool->SetMemoryLimits(32 * 1024, MemoryPool::NO_MEMORY_LIMIT);
+	MemoryPool::MemoryPool *ptrChildPool = (bOk ? ptrMemPool->CreateChildPool(8 * 1024) : NULL);
+	MemoryCache cache;
+	cache.ObjectSize = 1024;
+	cache.Pool = ptrChildPool;
+	cache.PressureCount = 0;
+	ptrMemPool->AddMemoryPressureCallback(ShedMemoryCache, &cache);
+	bOk = (ptrChildPool != NULL);
+	while (bOk && (cache.PressureCount == 0))
+	{
+		void *ptrObject = ptrChildPool->GetMemory(cache.ObjectSize);
+		bOk = (ptrObject != NULL);
+		if (bOk)
+		{
+			cache.Objects.push_back(ptrObject);
+		}
+	}
+	//Only the object of the request which crossed the limit is left, it is returned after the callback was called
+	bOk = bOk && (cache.Objects.size() == 1) && (ptrChildPool->GetUsedMemoryPoolSize() == cache.ObjectSize);
+	delete ptrChildPool;
+	delete ptrMemPool;
+
+	//A child growing at the hard limit of the parent : the parent trims its unused Segments, and waits for memory (MEMORY_LIMIT_WAIT),
+	//as for a request of its own
+	const std::size_t sSegmentSize = 8 * 1024;
+	ptrMemPool = new MemoryPool::MemoryPool(sSegmentSize, MemoryPool::DEFAULT_MEMORY_CHUNK_SIZE, sSegmentSize);
+	for (unsigned int i = 0; i < 3; i++)
+	{
+		ptrObjects[i] = ptrMemPool->GetMemory(sSegmentSize);
+		bOk = bOk && (ptrObjects[i] != NULL);
+	}
+	for (unsigned int i = 0; bOk && (i < 3); i++)
+	{
+		ptrMemPool->FreeMemory(ptrObjects[i], sSegmentSize);	//3 unused Segments
+	}
+	ptrMemPool->SetMemoryLimits(MemoryPool::NO_MEMORY_LIMIT, 4 * sSegmentSize, MemoryPool::MEMORY_LIMIT_WAIT, 2000);
+	ptrChildPool = (bOk ? ptrMemPool->CreateChildPool(sSegmentSize) : NULL);
+	bOk = (ptrChildPool != NULL) && (ptrMemPool->GetMemoryPoolSize() == 4 * sSegmentSize) && (ptrChildPool->GetMemory(sSegmentSize) != NULL);
+	bOk = bOk && (ptrChildPool->GetMemory(sSegmentSize / 2) != NULL);	//the parent has to trim, to lend another Segment
+	bOk = bOk && (ptrMemPool->GetMemoryPoolSize() == 3 * sSegmentSize);
+
+	MemoryPool::MemoryPool *ptrOtherChildPool = (bOk ? ptrMemPool->CreateChildPool(sSegmentSize) : NULL);
+	bOk = bOk && (ptrOtherChildPool != NULL) && (ptrMemPool->GetMemoryPoolSize() == 4 * sSegmentSize);
+	std::thread deleteThread([ptrOtherChildPool]()
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		delete ptrOtherChildPool;	//gives its Segment back to the parent
+	});
+	bOk = bOk && (ptrChildPool->GetMemory(sSegmentSize) != NULL);	//waits for the Segment of the other child
+	deleteThread.join();
+	delete ptrChildPool;
+	delete ptrMemPool;
+	std::cerr << (bOk ? "OK" : "FAILED") << std::endl;
+
+	//Session churn : every session allocates its objects and releases all of them at the end
+	clock_t start, finish;
+	start = clock();
+	ptrMemPool = new MemoryPool::MemoryPool(MemoryPool::DEFAULT_MEMORY_POOL_SIZE, MemoryPool::DEFAULT_MEMORY_CHUNK_SIZE, 64 * 1024);
+	for (unsigned int uiSession = 0; uiSession < uiSessionCount; uiSession++)
+	{
+		for (unsigned int i = 0; i < uiObjectsPerSession; i++)
+		{
+			ptrObjects[i] = ptrMemPool->GetMemory(sObjectSize);
+		}
+		for (unsigned int i = 0; i < uiObjectsPerSession; i++)
+		{
+			ptrMemPool->FreeMemory(ptrObjects[i], sObjectSize);
+		}
+	}
+	delete ptrMemPool;
+	finish = clock();
+	double dPoolTime = (double)(finish - start) / CLOCKS_PER_SEC;
+
+	start = clock();
+	ptrMemPool = new MemoryPool::MemoryPool(MemoryPool::DEFAULT_MEMORY_POOL_SIZE, MemoryPool::DEFAULT_MEMORY_CHUNK_SIZE, 64 * 1024);
+	for (unsigned int uiSession = 0; uiSession < uiSessionCount; uiSession++)
+	{
+		MemoryPool::MemoryPool *ptrChildPool = ptrMemPool->CreateChildPool();
+		for (unsigned int i = 0; i < uiObjectsPerSession; i++)
+		{
+			ptrObjects[i] = ptrChildPool->GetMemory(sObjectSize);
+		}
+		delete ptrChildPool;
+	}
+	delete ptrMemPool;
+	finish = clock();
+	double dChildPoolTime = (double)(finish - start) / CLOCKS_PER_SEC;
+	delete[] ptrObjects;
+
+	std::cerr << "Result for MemoryPool(FreeMemory)    : " << dPoolTime << " s" << std::endl;
+	std::cerr << "Result for MemoryPool(ChildPool)     : " << dChildPoolTime << " s" << std::endl;
+}
+
 //
 //WriteMemoryDumpToFile
 //
@@ -207,6 +1024,18 @@ void WriteMemoryDumpToFile()
 int main(int argc, const char *argv[])
 {
 	std::cout << "MemoryPool Program started..." << std::endl;
+	TestPoolCreationSpeed();
+	TestHandleCompaction();
+	TestLargeRequests();
+	TestZeroSizeRequests();
+	TestSharedMemoryPool();
+	TestSharedMemoryOwnerDied();
+	TestSharedMemoryThroughput();
+	TestPersistentPool();
+	TestHeapProfiler();
+	TestMemoryLimits();
+	TestChildPools();
+
 	CreateGlobalMemPool();
 
 	TestAllocationSpeedArrayMemPool();